@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""Makes one file out of a sketch and the libraries it includes from libraries/, for Tinkercad,
+which only takes one file. Each #include <X.h> with a libraries/X/X.h is replaced by that file,
+the first time only, and so are the includes inside it. Anything else, like <Keypad.h>, is left
+for the simulator to supply.
+
+The library text is marked off with #line directives, the same as the preprocessor marks off an
+included header, so errors point at the library file and the Arduino IDE only makes prototypes
+for the sketch's own functions, the same as when the libraries are included. sim/prototypes.py
+does the same, so a bundle can be checked on the host:
+
+  python3 bundle.py ../task5/5.4.cpp > bin/5.4.cpp
+  python3 sim/prototypes.py bin/5.4.cpp > bin/gen/5.4.cpp
+
+Usage: bundle.py sketch.cpp > sketch_for_tinkercad.cpp
+"""
+import os
+import re
+import sys
+
+LIBRARIES = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'libraries')
+INCLUDE = re.compile(r'^\s*#\s*include\s*<(\w+)\.h>')
+
+
+def bundle(path, name, out, seen):
+    for number, line in enumerate(open(path).read().split('\n'), 1):
+        m = INCLUDE.match(line)
+        library = m and os.path.join(LIBRARIES, m.group(1), m.group(1) + '.h')
+        if not library or not os.path.exists(library):
+            out.append(line)
+            continue
+
+        out.append(f'// {line.strip()}')
+        if m.group(1) in seen:
+            continue
+        seen.add(m.group(1))
+        out.append(f'#line 1 "libraries/{m.group(1)}/{m.group(1)}.h"')
+        bundle(library, f'libraries/{m.group(1)}/{m.group(1)}.h', out, seen)
+        out.append(f'#line {number + 1} "{name}"')
+
+
+def main(path):
+    out = []
+    bundle(path, path, out, set())
+    sys.stdout.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1])
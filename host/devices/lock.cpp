@@ -0,0 +1,22 @@
+// task5/5.2.cpp, the keypad lock, as a simulated device
+#include "5.2.cpp" // bin/gen/5.2.cpp, the sketch with its prototypes added by sim/prototypes.py
+
+// The key queue stays consistent and the servo is where the state says once it has finished moving
+const char* check() {
+  static LockState last = LOCK_LOCKED;
+  bool settled = lock_state == last;
+  last = lock_state;
+
+  if (lock_queue_count > LOCK_KEY_QUEUE)
+    return "key queue count out of bounds";
+  if (lock_queue_front >= LOCK_KEY_QUEUE)
+    return "key queue index out of bounds";
+
+  if (settled && lock_state == LOCK_LOCKED && servoDone() && servoAngle() != LOCK_LOCKED_ANGLE)
+    return "locked but the servo isn't at 90";
+  if (settled && lock_state == LOCK_UNLOCKED && servoDone() && servoAngle() != LOCK_UNLOCKED_ANGLE)
+    return "unlocked but the servo isn't at 0";
+  return nullptr;
+}
+
+SIM_DEVICE("lock", lock_state, lock_state_names, check, nullptr)
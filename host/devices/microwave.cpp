@@ -0,0 +1,38 @@
+// task5/5.4.cpp, the microwave, as a simulated device
+#include "5.4.cpp" // bin/gen/5.4.cpp, the sketch with its prototypes added by sim/prototypes.py
+
+bool last_buttons[2] = {false, false}; // start/pause and stop after the last check
+long last_button_change = -MICROWAVE_DEBOUNCE; // millis() the check last saw one change
+
+// The microwave is never on after a loop that read the door open, whatever the state machine
+// made of the reading, or outside of RUNNING, and start/pause and stop aren't taken again within
+// MICROWAVE_DEBOUNCE of the last press. The states clear those once they've acted on a press, so
+// only presses are changes from the pins.
+const char* check() {
+  if (sim_pins[MICROWAVE_PIN] && !sim_inputs[INTERLOCK_PIN])
+    return "microwave on with the door open";
+  if (sim_pins[MICROWAVE_PIN] && microwave_state != MICROWAVE_RUNNING)
+    return "microwave on outside of running";
+
+  bool buttons[2] = {microwave_start_pause, microwave_stop};
+  bool changed = (buttons[0] && !last_buttons[0]) || (buttons[1] && !last_buttons[1]);
+  memcpy(last_buttons, buttons, sizeof(buttons));
+  if (changed) {
+    long now = millis();
+    bool bounced = now - last_button_change < MICROWAVE_DEBOUNCE;
+    last_button_change = now;
+    if (bounced)
+      return "button changed within MICROWAVE_DEBOUNCE of the last change";
+  }
+  return nullptr;
+}
+
+// Each loop reads the time byte, the pot, start/pause, stop and the interlock
+const char* const regressions[] = {
+  // door shut, start 200 ms later and the door opened on the next loop: the interlock was
+  // debounced with the buttons, so the relay came on with the door open
+  "0000000001" "c400010001" "0000010000",
+  nullptr
+};
+
+SIM_DEVICE("microwave", microwave_state, microwave_state_names, check, regressions)
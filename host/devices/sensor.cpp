@@ -0,0 +1,22 @@
+// task5/5.3.cpp, the potentiometer and ultrasonic sensor state machine, as a simulated device
+#include "5.3.cpp" // bin/gen/5.3.cpp, the sketch with its prototypes added by sim/prototypes.py
+
+// The fade stays in range and every sensor's median window is consistent
+const char* check() {
+  if (led_brightness < 0 || led_brightness > 255)
+    return "LED brightness out of range";
+
+  for (byte s = 0; s < NUM_DEPTH_SENSORS; s++) {
+    const Range& range = ranges[s];
+    if (range.count > MEDIAN_SIZE || range.next >= MEDIAN_SIZE)
+      return "median window out of bounds";
+    for (byte i = 1; i < range.count; i++)
+      if (range.sorted[i - 1] > range.sorted[i])
+        return "median window out of order";
+    if (range.count > 0 && range.distance != range.sorted[range.count / 2])
+      return "distance isn't the median";
+  }
+  return nullptr;
+}
+
+SIM_DEVICE("sensor", currentState, stateNames, check, nullptr)
@@ -0,0 +1,420 @@
+/* Load tests the task5 state machines by running thousands of simulated devices with random
+ * inputs over every core, and reports how fast they ran, how long they spent in each state and
+ * which transitions they took.
+ *
+ * Usage: fleet [options] device.so...
+ *   -n count    instances of every device (default 1000)
+ *   -d seconds  device time every instance runs for (default 60)
+ *   -t threads  worker threads (default one per core)
+ *   -s seed     seed for the instances' inputs (default 1)
+ *   -S          run with 1, 2, 4... up to -t threads and report the speedup of each over the
+ *               one thread run, without it there's nothing to compare against and no speedup
+ *
+ * Every worker thread loads its own copy of every device library, so no two threads ever share
+ * a global. A worker resets its copy to power on between instances by restoring a snapshot of
+ * the library's globals (see sim/snapshot.h), then runs the instance's setup() and loop() with
+ * its own clock and random inputs seeded from its number, so any instance can be run again on
+ * its own. Instances are queued round robin on the workers and an idle worker steals from the
+ * others, since the devices take very different amounts of time per loop.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "sim/device.h"
+#include "sim/sim.h"
+#include "sim/snapshot.h"
+
+// splitmix64, small and good enough for inputs
+struct Random {
+  uint64_t state;
+
+  uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+  int below(int n) { return next() % n; }
+
+  // Time until the next event of something that happens every `mean` us on average
+  uint64_t exponential(double mean) { return (uint64_t)(-mean * log(1 - uniform())) + 1; }
+};
+
+/* Random inputs for one instance. Every input is a function of the device's clock rather than
+ * of how often it is read, so the same seed gives the same inputs whatever the sketch does.
+ *   analog   a random walk that jumps somewhere new every few seconds
+ *   digital  held HIGH for 300 ms and LOW for 2 s on average, like a button being pressed
+ *   pulse    an object wandering 2-450 cm away, missing the echo now and then
+ *   keys     a press every half second, mostly typing one of the codes the sketches know
+ */
+struct Inputs {
+  static const int PINS = 32;
+  static const char* const CODES[];
+
+  Random random;
+  const uint64_t* clock;
+  uint64_t last[PINS];       // time each pin was last read
+  double analog[PINS];
+  bool level[PINS];
+  uint64_t flip[PINS];       // when each digital pin next changes
+  double distance = 100;     // cm
+  uint64_t next_key = 0;
+  const char* typing = "";   // the rest of the code being typed
+
+  Inputs(uint64_t seed, const uint64_t* clock) : random{seed}, clock(clock) {
+    for (int p = 0; p < PINS; p++) {
+      last[p] = 0;
+      analog[p] = random.below(1024);
+      level[p] = false;
+      flip[p] = random.exponential(2e6);
+    }
+  }
+
+  int analogRead(uint8_t pin) {
+    pin %= PINS;
+    double seconds = (*clock - last[pin]) / 1e6;
+    last[pin] = *clock;
+
+    if (random.uniform() < seconds / 5)
+      analog[pin] = random.below(1024);
+    else
+      analog[pin] += (random.uniform() - 0.5) * 200 * sqrt(seconds);
+    analog[pin] = std::min(1023.0, std::max(0.0, analog[pin]));
+    return (int)analog[pin];
+  }
+
+  int digitalRead(uint8_t pin) {
+    pin %= PINS;
+    while (*clock >= flip[pin]) {
+      level[pin] = !level[pin];
+      flip[pin] += random.exponential(level[pin] ? 3e5 : 2e6);
+    }
+    return level[pin];
+  }
+
+  unsigned long pulseIn(uint8_t pin, unsigned long timeout) {
+    pin %= PINS;
+    double seconds = (*clock - last[pin]) / 1e6;
+    last[pin] = *clock;
+
+    distance += (random.uniform() - 0.5) * 100 * sqrt(seconds);
+    distance = std::min(450.0, std::max(2.0, distance));
+    if (random.uniform() < 0.05)
+      return 0;
+    unsigned long time = distance * 2 / 0.034;
+    return time <= timeout ? time : 0;
+  }
+
+  char getKey() {
+    if (*clock < next_key)
+      return 0;
+    next_key = *clock + random.exponential(5e5);
+
+    if (!*typing) {
+      if (random.uniform() < 0.2)
+        return "1234567890*#ABCD"[random.below(16)];
+      typing = CODES[random.below(7)];
+    }
+    return *typing++;
+  }
+};
+const char* const Inputs::CODES[] = {"1234", "1324", "4231", "4321", "2", "3", "4"};
+
+struct DeviceStats {
+  uint64_t instances = 0;
+  uint64_t loops = 0;
+  uint64_t time = 0;                 // us of device time
+  std::vector<uint64_t> occupancy;   // us in each state
+  std::vector<uint64_t> transitions; // from * num_states + to
+
+  void merge(const DeviceStats& other) {
+    instances += other.instances;
+    loops += other.loops;
+    time += other.time;
+    occupancy.resize(std::max(occupancy.size(), other.occupancy.size()));
+    transitions.resize(std::max(transitions.size(), other.transitions.size()));
+    for (size_t i = 0; i < other.occupancy.size(); i++)
+      occupancy[i] += other.occupancy[i];
+    for (size_t i = 0; i < other.transitions.size(); i++)
+      transitions[i] += other.transitions[i];
+  }
+};
+
+struct Job {
+  int device;
+  uint64_t seed;
+};
+
+struct Loaded {
+  SimDevice* device;
+  SimSnapshot power_on;
+};
+
+struct Worker {
+  std::deque<Job> jobs;
+  std::mutex lock;
+  std::vector<Loaded> devices;
+  std::vector<DeviceStats> stats;
+  uint64_t stolen = 0;
+};
+
+struct Fleet {
+  std::vector<std::string> paths;
+  uint64_t duration;   // us of device time per instance
+  std::vector<Worker*> workers;
+
+  // Load a private copy of a device library. dlopen() only loads a path once, so the library is
+  // copied to a new file first.
+  bool load(const std::string& path, Loaded& loaded) {
+    char copy[] = "/tmp/fleet_XXXXXX.so";
+    int out = mkstemps(copy, 3);
+    FILE* in = fopen(path.c_str(), "rb");
+    if (out < 0 || !in) {
+      fprintf(stderr, "%s: can't copy the library\n", path.c_str());
+      return false;
+    }
+
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+      if (write(out, buffer, n) != (ssize_t)n)
+        break;
+    fclose(in);
+    close(out);
+
+    void* handle = nullptr;
+    loaded.device = simLoad(copy, &handle);
+    unlink(copy);
+    if (!loaded.device)
+      return false;
+    if (!loaded.power_on.take(handle)) {
+      fprintf(stderr, "%s: can't find the library's globals\n", path.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  void run(Worker& worker, const Job& job) {
+    const Loaded& loaded = worker.devices[job.device];
+    SimDevice* d = loaded.device;
+    DeviceStats& stats = worker.stats[job.device];
+    loaded.power_on.restore();
+
+    Inputs inputs(job.seed, d->micros);
+    SimHooks hooks = {
+      &inputs,
+      [](void* i, uint8_t pin) { return ((Inputs*)i)->analogRead(pin); },
+      [](void* i, uint8_t pin) { return ((Inputs*)i)->digitalRead(pin); },
+      [](void* i, uint8_t pin, uint8_t, unsigned long timeout) { return ((Inputs*)i)->pulseIn(pin, timeout); },
+      [](void* i) { return ((Inputs*)i)->getKey(); },
+      nullptr,
+      nullptr,
+    };
+    *d->hooks = hooks;
+    *d->micros = 0;
+
+    d->setup();
+    int state = d->state();
+    while (*d->micros < duration) {
+      uint64_t start = *d->micros;
+      d->loop();
+      // the host can't tell how long a loop that never delays takes, call it 1 ms
+      if (*d->micros == start)
+        *d->micros += 1000;
+
+      stats.loops++;
+      stats.occupancy[state] += *d->micros - start;
+      int now = d->state();
+      if (now != state) {
+        stats.transitions[state * d->num_states + now]++;
+        state = now;
+      }
+    }
+    stats.instances++;
+    stats.time += *d->micros;
+  }
+
+  // Own jobs come off the back, stolen ones off the front of someone else's
+  bool next(int id, Job& job) {
+    Worker& self = *workers[id];
+    {
+      std::lock_guard<std::mutex> guard(self.lock);
+      if (!self.jobs.empty()) {
+        job = self.jobs.back();
+        self.jobs.pop_back();
+        return true;
+      }
+    }
+
+    for (size_t i = 1; i < workers.size(); i++) {
+      Worker& victim = *workers[(id + i) % workers.size()];
+      std::lock_guard<std::mutex> guard(victim.lock);
+      if (!victim.jobs.empty()) {
+        job = victim.jobs.front();
+        victim.jobs.pop_front();
+        self.stolen++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns the stats of every device, or an empty list if a library wouldn't load
+  std::vector<DeviceStats> simulate(int threads, int instances, uint64_t seed, double& wall, uint64_t& stolen) {
+    workers.clear();
+    for (int t = 0; t < threads; t++)
+      workers.push_back(new Worker());
+
+    // every instance of every device, dealt out round robin
+    int n = 0;
+    for (int i = 0; i < instances; i++)
+      for (size_t d = 0; d < paths.size(); d++, n++)
+        workers[n % threads]->jobs.push_back(Job{(int)d, seed * 1000003 + n});
+
+    // every worker's copies are loaded before the clock starts, copying and opening the
+    // libraries isn't part of what's being measured
+    std::atomic<bool> failed(false);
+    for (int t = 0; t < threads && !failed; t++) {
+      Worker& worker = *workers[t];
+      for (size_t d = 0; d < paths.size(); d++) {
+        Loaded loaded;
+        if (!load(paths[d], loaded)) {
+          failed = true;
+          break;
+        }
+        worker.devices.push_back(loaded);
+        worker.stats.push_back(DeviceStats());
+        worker.stats[d].occupancy.resize(loaded.device->num_states);
+        worker.stats[d].transitions.resize(loaded.device->num_states * loaded.device->num_states);
+      }
+    }
+
+    std::vector<std::thread> pool;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads && !failed; t++) {
+      pool.emplace_back([this, t, &failed]() {
+        Worker& worker = *workers[t];
+        Job job;
+        while (!failed && next(t, job))
+          run(worker, job);
+      });
+    }
+    for (size_t t = 0; t < pool.size(); t++)
+      pool[t].join();
+    wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<DeviceStats> totals(paths.size());
+    stolen = 0;
+    for (size_t t = 0; t < workers.size(); t++) {
+      for (size_t d = 0; !failed && d < workers[t]->stats.size(); d++)
+        totals[d].merge(workers[t]->stats[d]);
+      stolen += workers[t]->stolen;
+      delete workers[t];
+    }
+    workers.clear();
+    return failed ? std::vector<DeviceStats>() : totals;
+  }
+};
+
+void report(const std::vector<SimDevice*>& devices, const std::vector<DeviceStats>& stats) {
+  for (size_t d = 0; d < devices.size(); d++) {
+    const SimDevice* device = devices[d];
+    const DeviceStats& s = stats[d];
+    printf("\n%s: %lu instances, %lu loops, %.0f s of device time\n",
+           device->name, (unsigned long)s.instances, (unsigned long)s.loops, s.time / 1e6);
+
+    printf("  time in state:");
+    for (int i = 0; i < device->num_states; i++)
+      printf("  %s %.1f%%", device->state_names[i], s.time ? 100.0 * s.occupancy[i] / s.time : 0.0);
+    printf("\n  transitions:");
+    for (int from = 0; from < device->num_states; from++) {
+      for (int to = 0; to < device->num_states; to++) {
+        uint64_t count = s.transitions[from * device->num_states + to];
+        if (count)
+          printf("  %s->%s %lu", device->state_names[from], device->state_names[to], (unsigned long)count);
+      }
+    }
+    printf("\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  int instances = 1000, threads = std::max(1u, std::thread::hardware_concurrency());
+  double seconds = 60;
+  uint64_t seed = 1;
+  bool scaling = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:d:t:s:S")) != -1) {
+    switch (opt) {
+    case 'n': instances = atoi(optarg); break;
+    case 'd': seconds = atof(optarg); break;
+    case 't': threads = std::max(1, atoi(optarg)); break;
+    case 's': seed = strtoull(optarg, nullptr, 10); break;
+    case 'S': scaling = true; break;
+    default: return 64;
+    }
+  }
+  if (optind == argc) {
+    fprintf(stderr, "Usage: fleet [-n instances] [-d seconds] [-t threads] [-s seed] [-S] device.so...\n");
+    return 64;
+  }
+
+  Fleet fleet;
+  fleet.duration = seconds * 1e6;
+  std::vector<SimDevice*> devices;
+  for (int i = optind; i < argc; i++) {
+    // loaded once here for names, every worker loads its own copy
+    SimDevice* device = simLoad(argv[i]);
+    if (!device)
+      return 1;
+    fleet.paths.push_back(argv[i]);
+    devices.push_back(device);
+  }
+
+  std::vector<int> counts;
+  for (int t = 1; scaling && t < threads; t *= 2)
+    counts.push_back(t);
+  counts.push_back(threads);
+
+  double base = 0;
+  std::vector<DeviceStats> stats;
+  for (size_t c = 0; c < counts.size(); c++) {
+    double wall;
+    uint64_t stolen;
+    stats = fleet.simulate(counts[c], instances, seed, wall, stolen);
+    if (stats.empty())
+      return 1;
+
+    uint64_t loops = 0;
+    for (size_t d = 0; d < stats.size(); d++)
+      loops += stats[d].loops;
+    double rate = loops / wall;
+    if (counts[c] == 1)
+      base = rate;
+
+    printf("%d threads: %lu instances, %lu loops in %.2f s, %.0f loops/s, ",
+           counts[c], (unsigned long)(instances * devices.size()), (unsigned long)loops, wall, rate);
+    // the speedup is only known against a run that really had one thread
+    if (base > 0)
+      printf("%.2fx one thread, ", rate / base);
+    else
+      printf("speedup not measured (-S), ");
+    printf("%lu stolen\n", (unsigned long)stolen);
+  }
+
+  report(devices, stats);
+  return 0;
+}
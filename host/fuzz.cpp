@@ -0,0 +1,460 @@
+/* Coverage guided fuzzing of the task5 state machines on the host.
+ *
+ * Usage: fuzz [options] device.so
+ *   -t seconds  how long to fuzz for (default 60)
+ *   -n runs     stop after this many runs instead
+ *   -l bytes    longest input to try (default 256)
+ *   -o dir      where to write reproducers (default .)
+ *   -s seed     seed for the mutations (default 1)
+ *   -d codes    key sequences worth trying, separated by commas, like the codes in the sketch
+ *
+ * The device library has to be built with -fsanitize-coverage=trace-pc (the "fuzzers" alias in
+ * host/setup.sh) so every basic block it runs calls __sanitizer_cov_trace_pc() below, which
+ * counts the edges between blocks AFL style. Inputs that reach a new edge, or an edge a new
+ * number of times, are kept and mutated further.
+ *
+ * Every run resets the device to just after setup() by restoring a snapshot of its globals and
+ * turns the input bytes into what the sketch reads, loop by loop:
+ *   every loop   1 byte, from 0xc0 up it first moves the clock on (b & 0x3f) * 50 ms
+ *   analogRead   1 byte, under 0x80 reads the same as last time, else 2 bytes make a new reading
+ *   digitalRead  1 byte, bit 0 is the level
+ *   pulseIn      1 byte, under 0x80 the same, 0xff no echo, else 2 bytes make a distance in cm
+ *   getKey       1 byte, from 0xc0 up a key press, else nothing
+ * After every loop the state has to be in range and the device's own invariants (the check in
+ * its host/devices file) have to hold. When one doesn't the input is cut down to the smallest
+ * that still breaks it the same way and written out as a raw trace, in the format host/replay
+ * reads, and as the input bytes.
+ *
+ * The inputs a device lists as regressions (see SIM_DEVICE) are run first, a fix that's come
+ * undone is reported like any other failure, and they start off the inputs that get mutated.
+ *
+ * The devices are built with NO_DEBUG so the sketches don't build and print their debug
+ * messages on every loop, which was most of the time a run took. On one core that leaves about
+ * 110k runs a second for the lock, 70k for the microwave and 40k for the sensor, short of the
+ * hundreds of thousands asked for. Half of a run is now the coverage hook, which the sketches call
+ * 1000 to 3000 times a run at about 4 ns each, and most of the rest is the sketch itself. Clang's
+ * inline counters would take the call out, but these build with g++.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "sim/device.h"
+#include "sim/sim.h"
+#include "sim/snapshot.h"
+#include "sim/trace.h"
+
+const int MAX_LOOPS = 2000;       // loops in one run, however long the input
+const char KEYS[] = "123A456B789C*0#D";
+
+// Edge coverage, filled in by the device as it runs
+const int MAP_SIZE = 1 << 13;
+alignas(8) uint8_t coverage[MAP_SIZE];
+uintptr_t previous_block = 0;
+
+extern "C" void __sanitizer_cov_trace_pc() {
+  uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+  uintptr_t block = (pc ^ (pc >> 13)) & (MAP_SIZE - 1);
+  coverage[block ^ previous_block]++;
+  previous_block = block >> 1;
+}
+
+
+// Serves the input bytes to the sketch and records what it served as a trace
+struct FuzzInputs {
+  const uint8_t* data;
+  size_t size, at;
+  bool exhausted;
+  bool recording;
+  std::vector<TraceRecord> trace;
+  uint32_t last[32];
+  bool seen[32];
+
+  void reset(const uint8_t* data, size_t size, bool recording) {
+    this->data = data;
+    this->size = size;
+    this->recording = recording;
+    at = 0;
+    exhausted = false;
+    trace.clear();
+    memset(seen, 0, sizeof(seen));
+  }
+
+  // Past the end of the input everything reads as 0, the run stops at the end of the loop
+  uint8_t next() {
+    if (at < size)
+      return data[at++];
+    exhausted = true;
+    return 0;
+  }
+
+  void record(uint8_t kind, uint8_t pin, uint32_t value) {
+    if (recording)
+      trace.push_back(TraceRecord{kind, pin, value});
+  }
+
+  // Record a reading from a pin as TRACE_SAME if it hasn't changed, like the sketches do
+  uint32_t reading(uint8_t kind, uint8_t pin, uint32_t value) {
+    pin &= 31;
+    if (seen[pin] && last[pin] == value) {
+      record(TRACE_SAME, pin, 0);
+    } else {
+      record(kind, pin, value);
+      last[pin] = value;
+      seen[pin] = true;
+    }
+    return value;
+  }
+
+  uint32_t same(uint8_t pin) {
+    pin &= 31;
+    return seen[pin] ? last[pin] : 0;
+  }
+
+  int analogRead(uint8_t pin) {
+    uint8_t b = next();
+    if (b < 0x80)
+      return reading(TRACE_ANALOG, pin, same(pin));
+    return reading(TRACE_ANALOG, pin, ((b & 0x7f) << 3 | next() >> 5) & 1023);
+  }
+
+  int digitalRead(uint8_t pin) {
+    return reading(TRACE_DIGITAL, pin, next() & 1);
+  }
+
+  unsigned long pulseIn(uint8_t pin, unsigned long timeout) {
+    uint8_t b = next();
+    unsigned long time;
+    if (b < 0x80) {
+      time = same(pin);
+    } else if (b == 0xff) {
+      time = 0;
+    } else {
+      unsigned long cm = ((b & 0x7f) << 8 | next()) % 500;
+      time = cm * 2 / 0.034;
+      if (time > timeout)
+        time = 0;
+    }
+    return reading(TRACE_PULSE, pin, time);
+  }
+
+  char getKey() {
+    uint8_t b = next();
+    if (b < 0xc0) {
+      record(TRACE_NO_KEY, 0, 0);
+      return 0;
+    }
+    char key = KEYS[b & 0xf];
+    record(TRACE_KEY, 0, (uint8_t)key);
+    return key;
+  }
+};
+
+
+struct Fuzzer {
+  SimDevice* device;
+  SimSnapshot after_setup;
+  FuzzInputs inputs;
+  unsigned long loops;
+
+  bool begin(const char* path) {
+    void* handle = nullptr;
+    if (!(device = simLoad(path, &handle)))
+      return false;
+
+    SimHooks hooks = {
+      &inputs,
+      [](void* i, uint8_t pin) { return ((FuzzInputs*)i)->analogRead(pin); },
+      [](void* i, uint8_t pin) { return ((FuzzInputs*)i)->digitalRead(pin); },
+      [](void* i, uint8_t pin, uint8_t, unsigned long timeout) { return ((FuzzInputs*)i)->pulseIn(pin, timeout); },
+      [](void* i) { return ((FuzzInputs*)i)->getKey(); },
+      nullptr,
+      nullptr,
+    };
+    *device->hooks = hooks;
+    *device->micros = 0;
+
+    // the sketches don't read any inputs in setup(), so every run can start after it
+    inputs.reset(nullptr, 0, false);
+    device->setup();
+    if (inputs.at || inputs.exhausted)
+      fprintf(stderr, "warning: %s reads inputs in setup(), reproducers won't replay\n", device->name);
+
+    if (!after_setup.take(handle)) {
+      fprintf(stderr, "%s: can't find the library's globals\n", path);
+      return false;
+    }
+    return true;
+  }
+
+  // Run one input, returns what broke or null if nothing did
+  const char* run(const uint8_t* data, size_t size, bool recording=false) {
+    after_setup.restore();
+    inputs.reset(data, size, recording);
+    previous_block = 0;
+
+    const char* broke = nullptr;
+    uint64_t& clock = *device->micros;
+    unsigned long last_loop = 0; // the sketches trace the first loop's time from 0 too
+    for (loops = 0; loops < MAX_LOOPS && !broke && !inputs.exhausted; ) {
+      uint8_t b = inputs.next();
+      if (inputs.exhausted)
+        break;
+      // time jumps land on a ms so the trace, which only has ms, replays them exactly
+      if (b >= 0xc0)
+        clock = (clock / 1000 + (b & 0x3f) * 50) * 1000;
+      inputs.record(TRACE_LOOP, 0, clock / 1000 - last_loop);
+      last_loop = clock / 1000;
+
+      device->loop();
+      loops++;
+
+      int state = device->state();
+      if (state < 0 || state >= device->num_states)
+        broke = "state out of range";
+      else if (device->check)
+        broke = device->check();
+    }
+    return broke;
+  }
+};
+
+
+// AFL's hit count buckets, a bit each, so an edge only counts as new when it's hit a different
+// power of 2 times (about)
+uint8_t bucket(uint8_t hits) {
+  if (hits <= 2) return hits;
+  if (hits == 3) return 4;
+  if (hits <= 7) return 8;
+  if (hits <= 15) return 16;
+  if (hits <= 31) return 32;
+  if (hits <= 127) return 64;
+  return 128;
+}
+
+struct Random {
+  uint64_t state;
+  uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+  size_t below(size_t n) { return n ? next() % n : 0; }
+};
+
+void mutate(std::vector<uint8_t>& input, const std::vector<std::vector<uint8_t> >& corpus,
+            const std::vector<std::string>& codes, Random& random, size_t max_len) {
+  static const uint8_t interesting[] = {0x00, 0x01, 0x7f, 0x80, 0xbf, 0xc0, 0xc1, 0xc2, 0xc3, 0xff};
+
+  for (int n = 1 + random.below(4); n > 0; n--) {
+    size_t size = input.size();
+    switch (random.below(codes.empty() ? 7 : 8)) {
+    case 0: // flip a bit
+      if (size) input[random.below(size)] ^= 1 << random.below(8);
+      break;
+    case 1: // an interesting byte
+      if (size) input[random.below(size)] = interesting[random.below(sizeof(interesting))];
+      break;
+    case 2: // a key press
+      if (size) input[random.below(size)] = 0xc0 | random.below(16);
+      break;
+    case 3: { // insert random bytes
+      size_t at = random.below(size + 1), count = 1 + random.below(8);
+      for (size_t i = 0; i < count; i++)
+        input.insert(input.begin() + at, (uint8_t)random.next());
+      break;
+    }
+    case 4: { // delete some bytes
+      if (!size) break;
+      size_t at = random.below(size), count = 1 + random.below(std::min<size_t>(size - at, 16));
+      input.erase(input.begin() + at, input.begin() + at + count);
+      break;
+    }
+    case 5: { // repeat a piece, like typing the same code again
+      if (!size) break;
+      size_t from = random.below(size), count = 1 + random.below(std::min<size_t>(size - from, 32));
+      std::vector<uint8_t> piece(input.begin() + from, input.begin() + from + count);
+      input.insert(input.begin() + random.below(size + 1), piece.begin(), piece.end());
+      break;
+    }
+    case 6: { // splice in the end of another input
+      const std::vector<uint8_t>& other = corpus[random.below(corpus.size())];
+      if (other.empty()) break;
+      size_t at = random.below(size + 1), from = random.below(other.size());
+      input.resize(at);
+      input.insert(input.end(), other.begin() + from, other.end());
+      break;
+    }
+    case 7: { // type one of the codes, a few bytes apart so other reads can go in between
+      const std::string& code = codes[random.below(codes.size())];
+      size_t at = random.below(size + 1), stride = 1 + random.below(4);
+      if (input.size() < at + code.size() * stride)
+        input.resize(at + code.size() * stride);
+      for (size_t i = 0; i < code.size(); i++)
+        input[at + i * stride] = 0xc0 | (strchr(KEYS, code[i]) - KEYS);
+      break;
+    }
+    }
+  }
+  if (input.size() > max_len)
+    input.resize(max_len);
+}
+
+// Cut an input down to the smallest that still breaks the same way (delta debugging)
+std::vector<uint8_t> minimize(Fuzzer& fuzzer, std::vector<uint8_t> input, const std::string& failure) {
+  for (size_t chunk = std::max<size_t>(input.size() / 2, 1); ; chunk /= 2) {
+    for (size_t at = 0; at < input.size(); ) {
+      std::vector<uint8_t> smaller(input);
+      smaller.erase(smaller.begin() + at, smaller.begin() + std::min(at + chunk, smaller.size()));
+      const char* broke = fuzzer.run(smaller.data(), smaller.size());
+      if (broke && failure == broke)
+        input.swap(smaller);
+      else
+        at += chunk;
+    }
+    if (chunk == 1)
+      break;
+  }
+  return input;
+}
+
+// A regression's input, two hex digits a byte
+std::vector<uint8_t> fromHex(const char* hex) {
+  std::vector<uint8_t> data;
+  for (; hex[0] && hex[1]; hex += 2) {
+    char byte[3] = {hex[0], hex[1], '\0'};
+    data.push_back(strtoul(byte, nullptr, 16));
+  }
+  return data;
+}
+
+bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+void report(Fuzzer& fuzzer, const std::vector<uint8_t>& input, const std::string& failure, const std::string& out, int number) {
+  std::vector<uint8_t> smallest = minimize(fuzzer, input, failure);
+  fuzzer.run(smallest.data(), smallest.size(), true);
+
+  char name[64];
+  snprintf(name, sizeof(name), "/%s-%d", fuzzer.device->name, number);
+  std::string trace = out + name + ".trc", bytes = out + name + ".bin";
+  if (!traceSave(trace.c_str(), fuzzer.inputs.trace) || !writeFile(bytes, smallest))
+    fprintf(stderr, "can't write to %s\n", out.c_str());
+
+  printf("FAILED: %s after %lu loops, %zu byte input, replay with: replay %s.so %s\n",
+         failure.c_str(), fuzzer.loops, smallest.size(), fuzzer.device->name, trace.c_str());
+}
+
+
+int main(int argc, char** argv) {
+  double seconds = 60;
+  unsigned long max_runs = 0;
+  size_t max_len = 256;
+  std::string out = ".";
+  std::vector<std::string> codes;
+  Random random = {1};
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:l:o:s:d:")) != -1) {
+    switch (opt) {
+    case 't': seconds = atof(optarg); break;
+    case 'n': max_runs = strtoul(optarg, nullptr, 10); break;
+    case 'l': max_len = std::max(1, atoi(optarg)); break;
+    case 'o': out = optarg; break;
+    case 's': random.state = strtoull(optarg, nullptr, 10) | 1; break;
+    case 'd':
+      for (char* code = strtok(optarg, ","); code; code = strtok(nullptr, ","))
+        if (code[strspn(code, KEYS)] == '\0')
+          codes.push_back(code);
+      break;
+    default: return 64;
+    }
+  }
+  if (argc - optind != 1) {
+    fprintf(stderr, "Usage: fuzz [-t seconds] [-n runs] [-l bytes] [-o dir] [-s seed] [-d codes] device.so\n");
+    return 64;
+  }
+
+  Fuzzer fuzzer;
+  if (!fuzzer.begin(argv[optind]))
+    return 1;
+
+  alignas(8) static uint8_t seen[MAP_SIZE]; // every bucket each edge has been hit in, as bits
+  uint8_t buckets[256];
+  for (int hits = 0; hits < 256; hits++)
+    buckets[hits] = bucket(hits);
+  std::vector<std::vector<uint8_t> > corpus(1);
+  std::map<std::string, unsigned long> failures;
+  unsigned long runs = 0, edges = 0;
+
+  for (const char* const* r = fuzzer.device->regressions; r && *r; r++) {
+    std::vector<uint8_t> input = fromHex(*r);
+    const char* broke = fuzzer.run(input.data(), input.size());
+    if (broke && failures[broke]++ == 0)
+      report(fuzzer, input, broke, out, failures.size());
+    corpus.push_back(input);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(), last_status = start;
+  for (;;) {
+    std::vector<uint8_t> input = corpus[random.below(corpus.size())];
+    mutate(input, corpus, codes, random, max_len);
+
+    memset(coverage, 0, sizeof(coverage));
+    const char* broke = fuzzer.run(input.data(), input.size());
+    runs++;
+
+    // bucket the hits in place, 8 edges at a time, then an input is new if it set a bit that
+    // seen doesn't have. Most of the map is empty and most runs find nothing new
+    bool novel = false;
+    uint64_t* words = (uint64_t*)coverage;
+    uint64_t* seen_words = (uint64_t*)seen;
+    for (int w = 0; w < MAP_SIZE / 8; w++) {
+      if (!words[w])
+        continue;
+      uint8_t* hits = coverage + w * 8;
+      for (int i = 0; i < 8; i++)
+        hits[i] = buckets[hits[i]];
+      if (words[w] & ~seen_words[w]) {
+        for (int i = 0; i < 8; i++)
+          edges += hits[i] && !seen[w * 8 + i];
+        seen_words[w] |= words[w];
+        novel = true;
+      }
+    }
+    if (novel)
+      corpus.push_back(input);
+
+    if (broke && failures[broke]++ == 0)
+      report(fuzzer, input, broke, out, failures.size());
+
+    if ((runs & 1023) == 0 || (max_runs && runs >= max_runs)) {
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      double elapsed = std::chrono::duration<double>(now - start).count();
+      bool done = (max_runs && runs >= max_runs) || (!max_runs && elapsed >= seconds);
+      if (done || std::chrono::duration<double>(now - last_status).count() >= 1) {
+        last_status = now;
+        printf("%.0f s: %lu runs, %.0f runs/s, %lu edges, %zu inputs, %zu failures\n",
+               elapsed, runs, runs / elapsed, edges, corpus.size(), failures.size());
+        fflush(stdout);
+      }
+      if (done)
+        break;
+    }
+  }
+
+  for (std::map<std::string, unsigned long>::iterator f = failures.begin(); f != failures.end(); f++)
+    printf("%s: %lu runs\n", f->first.c_str(), f->second);
+  return failures.empty() ? 0 : 1;
+}
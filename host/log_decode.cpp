@@ -0,0 +1,152 @@
+/* Decodes the EEPROM sensor log dumped over serial (send 'D' to task4.4 or task5/5.3) into CSV.
+ *
+ * Usage: log_decode < serial_capture.txt > log.csv
+ *
+ * Any line that isn't part of the dump is skipped, so the whole serial capture can be passed in.
+ * The CSV has one row per record: the reset it came after (counting from the oldest in the log),
+ * seconds since that reset, then every channel as it was logged.
+ * See libraries/SensorLog/SensorLog.h for the format.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const uint8_t LOG_BOOT = 0x80;
+const int LOG_HEADER = 4;
+
+struct Page {
+  uint16_t seq;
+  bool boot;
+  std::vector<uint8_t> body;
+};
+
+// CRC-8 (polynomial 0x07), same as logCrc()
+uint8_t crc8(uint8_t crc, const uint8_t* data, size_t len) {
+  while (len--) {
+    crc ^= *data++;
+    for (int b = 0; b < 8; b++)
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+bool parseHex(const std::string& hex, std::vector<uint8_t>& out) {
+  if (hex.size() % 2)
+    return false;
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    unsigned int byte;
+    if (sscanf(hex.c_str() + i, "%2x", &byte) != 1)
+      return false;
+    out.push_back(byte);
+  }
+  return true;
+}
+
+// Read an unsigned varint, returns false if the page ends first
+bool varint(const std::vector<uint8_t>& body, size_t& at, uint32_t& value) {
+  value = 0;
+  for (int shift = 0; at < body.size() && shift < 35; shift += 7) {
+    uint8_t b = body[at++];
+    value |= uint32_t(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool zigzag(const std::vector<uint8_t>& body, size_t& at, int16_t& value) {
+  uint32_t raw;
+  if (!varint(body, at, raw))
+    return false;
+  value = int16_t((raw >> 1) ^ -(int32_t)(raw & 1));
+  return true;
+}
+
+int main() {
+  std::vector<Page> pages;
+  int channels = 0;
+  std::string line;
+
+  while (std::getline(std::cin, line)) {
+    std::istringstream words(line);
+    std::string kind, hex;
+    words >> kind;
+
+    if (kind == "LOG") {
+      int page_size;
+      words >> page_size >> channels;
+      pages.clear();
+    } else if (kind == "P" && words >> hex) {
+      std::vector<uint8_t> bytes;
+      if (!parseHex(hex, bytes) || bytes.size() < LOG_HEADER) {
+        std::cerr << "skipping malformed page: " << line << "\n";
+        continue;
+      }
+
+      size_t len = bytes[2] & ~LOG_BOOT;
+      if (bytes.size() != LOG_HEADER + len
+          || crc8(crc8(0, bytes.data(), 3), bytes.data() + LOG_HEADER, len) != bytes[3]) {
+        std::cerr << "skipping page with a bad CRC: " << line << "\n";
+        continue;
+      }
+
+      pages.push_back({uint16_t((bytes[0] << 8) | bytes[1]), bool(bytes[2] & LOG_BOOT),
+                       std::vector<uint8_t>(bytes.begin() + LOG_HEADER, bytes.end())});
+    }
+  }
+
+  if (channels == 0 || pages.empty()) {
+    std::cerr << "no log found in the input\n";
+    return 1;
+  }
+
+  // oldest first, allowing for the sequence number wrapping
+  uint16_t first = pages[0].seq;
+  std::sort(pages.begin(), pages.end(), [first](const Page& a, const Page& b) {
+    return uint16_t(a.seq - first) < uint16_t(b.seq - first);
+  });
+
+  std::cout << "boot,seconds";
+  for (int c = 0; c < channels; c++)
+    std::cout << ",ch" << c;
+  std::cout << "\n";
+
+  int boot = 0;
+  for (const Page& page : pages) {
+    if (page.boot && &page != &pages[0])
+      boot++;
+
+    uint32_t seconds = 0;
+    std::vector<int16_t> values(channels, 0);
+    size_t at = 0;
+
+    for (bool key = true; at < page.body.size(); key = false) {
+      uint32_t time;
+      if (!varint(page.body, at, time))
+        break;
+      seconds = key ? time : seconds + time;
+
+      bool complete = true;
+      for (int c = 0; c < channels && complete; c++) {
+        int16_t value = 0;
+        complete = zigzag(page.body, at, value);
+        values[c] = key ? value : values[c] + value;
+      }
+      if (!complete) {
+        std::cerr << "page " << page.seq << " ends part way through a record\n";
+        break;
+      }
+
+      std::cout << boot << "," << seconds;
+      for (int16_t value : values)
+        std::cout << "," << value;
+      std::cout << "\n";
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Reports where the RAM of each sketch goes and checks it against a budget.
+
+Usage: memreport.py [-r bytes] [-b bytes] [-n symbols] sketch.elf[:capture.txt]...
+
+For every sketch it prints the sizes of .data and .bss from the build, which are fixed, and
+when a serial capture is given the heap and stack high water marks from the "#M" lines the
+task5 sketches print when built with MEMORY_REPORT. The biggest variables in RAM are listed
+under each sketch, since they're usually what there is to move to flash or shrink.
+
+  -r bytes    RAM on the board (default 2048, an Uno)
+  -b bytes    fail if a sketch uses more than this (default the whole RAM)
+  -n symbols  how many of the biggest variables to list (default 5)
+
+The .elf is where arduino-cli compile --output-dir puts it, for example:
+  mkdir -p /tmp/5.2 && cp task5/5.2.cpp /tmp/5.2/5.2.ino
+  arduino-cli compile --fqbn arduino:avr:uno --libraries libraries --build-property compiler.cpp.extra_flags=-DMEMORY_REPORT \\
+    --output-dir /tmp/5.2/build /tmp/5.2
+and the capture is the serial monitor output from running that build for a while.
+
+Exits with 1 if any sketch is over budget.
+"""
+import getopt
+import os
+import struct
+import sys
+
+SHT_SYMTAB = 2
+STT_OBJECT = 1
+
+
+def readElf(path):
+    """Returns {section name: size} and [(size, name, section)] for the variables in an ELF."""
+    data = open(path, 'rb').read()
+    if data[:4] != b'\x7fELF':
+        raise ValueError('not an ELF file')
+    wide = data[4] == 2
+    end = '<' if data[5] == 1 else '>'
+
+    if wide:
+        shoff, = struct.unpack_from(end + 'Q', data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHH', data, 0x3a)
+        header = end + 'IIQQQQIIQQ'
+    else:
+        shoff, = struct.unpack_from(end + 'I', data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHH', data, 0x2e)
+        header = end + 'IIIIIIIIII'
+
+    # name, type, flags, addr, offset, size, link, info, addralign, entsize
+    headers = [struct.unpack_from(header, data, shoff + i * shentsize) for i in range(shnum)]
+    strtab = headers[shstrndx]
+
+    def name(table, offset):
+        start = table[4] + offset
+        return data[start:data.index(b'\0', start)].decode()
+
+    names = [name(strtab, h[0]) for h in headers]
+    sections = {n: h[5] for n, h in zip(names, headers)}
+
+    variables = []
+    for h in headers:
+        if h[1] != SHT_SYMTAB:
+            continue
+        strings = headers[h[6]]
+        for offset in range(h[4], h[4] + h[5], h[9]):
+            if wide:
+                st_name, st_info, _, st_shndx, _, st_size = struct.unpack_from(end + 'IBBHQQ', data, offset)
+            else:
+                st_name, _, st_size, st_info, _, st_shndx = struct.unpack_from(end + 'IIIBBH', data, offset)
+            if st_info & 0xf != STT_OBJECT or not st_size or st_shndx >= len(names):
+                continue
+            if names[st_shndx] in ('.data', '.bss', '.noinit'):
+                variables.append((st_size, name(strings, st_name), names[st_shndx]))
+    variables.sort(reverse=True)
+    return sections, variables
+
+
+def readCapture(path):
+    """Returns the highest heap and stack and the lowest unused RAM from the #M lines, or None."""
+    heap = stack = 0
+    unused = None
+    for line in open(path, errors='replace'):
+        fields = line.split()
+        if len(fields) != 5 or fields[0] != '#M':
+            continue
+        try:
+            _, h, s, u = (int(f) for f in fields[1:])
+        except ValueError:
+            continue
+        heap, stack = max(heap, h), max(stack, s)
+        unused = u if unused is None else min(unused, u)
+    return None if unused is None else (heap, stack, unused)
+
+
+def main(argv):
+    ram, budget, top = 2048, None, 5
+    try:
+        opts, args = getopt.getopt(argv, 'r:b:n:')
+    except getopt.GetoptError as e:
+        sys.exit(f'{e}\n{__doc__}')
+    for opt, value in opts:
+        if opt == '-r':
+            ram = int(value, 0)
+        elif opt == '-b':
+            budget = int(value, 0)
+        elif opt == '-n':
+            top = int(value)
+    if not args:
+        sys.exit(__doc__)
+    if budget is None:
+        budget = ram
+
+    over = False
+    print(f'{"sketch":<16} {"flash":>6} {".data":>6} {".bss":>6} {"heap":>6} {"stack":>6} {"unused":>6} {"used":>6}')
+    for arg in args:
+        elf, _, capture = arg.partition(':')
+        try:
+            sections, variables = readElf(elf)
+        except (OSError, ValueError, struct.error) as e:
+            print(f'{elf}: {e}', file=sys.stderr)
+            over = True
+            continue
+
+        data = sections.get('.data', 0)
+        bss = sections.get('.bss', 0) + sections.get('.noinit', 0)
+        flash = sections.get('.text', 0) + data
+        used = data + bss
+        heap = stack = unused = '-'
+        if capture:
+            marks = readCapture(capture)
+            if marks is None:
+                print(f'{capture}: no #M lines, was the sketch built with MEMORY_REPORT?', file=sys.stderr)
+            else:
+                heap, stack, unused = marks
+                used += heap + stack
+
+        name = os.path.basename(elf).split('.ino')[0]
+        print(f'{name:<16} {flash:>6} {data:>6} {bss:>6} {heap:>6} {stack:>6} {unused:>6} {used:>6}'
+              + ('  OVER BUDGET' if used > budget else ''))
+        for size, symbol, section in variables[:top]:
+            print(f'    {size:>6} {section:<7} {symbol}')
+        over |= used > budget
+
+    print(f'budget {budget} of {ram} bytes of RAM')
+    return 1 if over else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
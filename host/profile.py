@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""Says where a sketch spends its time, from the samples SampleProfiler prints.
+
+Usage: profile.py [-t prefix] [-n functions] [-l lines] sketch.elf capture.txt...
+
+The captures are serial output with the "#S" dumps from profilerDump(), from the board or from
+a simulator, with anything else on the lines around them. Every dump in every capture is added
+up. Each sampled address is looked up in the .elf, the function it's in with nm and the source
+line with addr2line. Two profiles are printed:
+
+  flat          the functions by how many of the samples were in them
+  per function  the source lines each of those functions was sampled at
+
+  -t prefix     put in front of nm and addr2line (default "avr-"), "" for a host build
+  -n functions  how many functions to list (default 20)
+  -l lines      how many lines to list for each function (default 5)
+
+The .elf is where arduino-cli compile --output-dir puts it, for example:
+  mkdir -p /tmp/5.2 && cp task5/5.2.cpp /tmp/5.2/5.2.ino
+  arduino-cli compile --fqbn arduino:avr:uno --libraries libraries --build-property compiler.cpp.extra_flags=-DPROFILE \\
+    --output-dir /tmp/5.2/build /tmp/5.2
+Build it with -g (the Arduino IDE does by default) for addr2line to have lines to give.
+
+simavr has no way to send a 'P', so for it add -DPROFILER_DUMP_MS=5000 to the extra flags and
+keep what it prints, the UART comes out on stderr:
+  timeout 60 simavr -m atmega328p -f 16000000 /tmp/5.2/build/5.2.ino.elf > capture.txt 2>&1
+That recipe hasn't been run yet, the stderr and colour handling are untried against a real
+simavr capture.
+"""
+import collections
+import getopt
+import re
+import subprocess
+import sys
+
+COLOUR = re.compile(r'\x1b\[[0-9;]*m') # simavr prints the UART in green
+
+
+def readDumps(paths):
+    """Returns {byte address: samples}, the rate, the shift and the samples dropped.
+
+    A dump whose counts were halved has them doubled back up, so dumps of different lengths add
+    up in proportion."""
+    counts = collections.Counter()
+    hz = shift = None
+    dropped = 0
+    for path in paths:
+        block = None
+        for line in open(path, errors='replace'):
+            at = line.find('#S ')
+            if at < 0:
+                continue
+            fields = COLOUR.sub('', line[at:]).split()
+            if len(fields) < 2:
+                continue # a bare "#S", cut off before anything useful
+            if fields[1] == 'start' and len(fields) == 7:
+                hz, shift, _, lost, halved = (int(f) for f in fields[2:])
+                dropped += lost
+                block = (collections.Counter(), 1 << halved)
+            elif fields[1] == 'end' and block:
+                for address, n in block[0].items():
+                    counts[address] += n * block[1]
+                block = None
+            elif block and len(fields) == 3:
+                try:
+                    block[0][int(fields[1], 16)] += int(fields[2])
+                except ValueError:
+                    pass # a line cut short, leave it out
+    return counts, hz, shift, dropped
+
+
+def readFunctions(elf, prefix):
+    """Returns [(start, end, name)] for the functions in the .elf, sorted by start."""
+    out = subprocess.run([prefix + 'nm', '-C', '-S', '-n', '--defined-only', elf],
+                         capture_output=True, text=True, check=True).stdout
+    functions = []
+    for line in out.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) == 4 and fields[2] in 'tTwW':
+            start, size = int(fields[0], 16), int(fields[1], 16)
+            functions.append((start, start + size, fields[3]))
+        elif len(fields) == 3 and fields[1] in 'tTwW':
+            # no size, it runs up to whatever comes next
+            functions.append((int(fields[0], 16), None, fields[2]))
+    for i, (start, end, name) in enumerate(functions):
+        if end is None:
+            end = functions[i + 1][0] if i + 1 < len(functions) else start + 2
+            functions[i] = (start, end, name)
+    return functions
+
+
+def functionAt(functions, address):
+    """The name of the function address is in, the smallest if they overlap."""
+    best = None
+    for start, end, name in functions:
+        if start > address:
+            break
+        if address < end and (best is None or end - start < best[0]):
+            best = (end - start, name)
+    return best[1] if best else '?'
+
+
+def readLines(elf, prefix, addresses):
+    """Returns {address: "file:line"}, with the file cut down to its name."""
+    if not addresses:
+        return {}
+    out = subprocess.run([prefix + 'addr2line', '-e', elf] + ['%x' % a for a in addresses],
+                         capture_output=True, text=True, check=True).stdout.splitlines()
+    return {a: l.rsplit('/', 1)[-1].split(' ')[0] for a, l in zip(addresses, out)}
+
+
+def main(argv):
+    prefix, top, per = 'avr-', 20, 5
+    try:
+        opts, args = getopt.getopt(argv, 't:n:l:')
+    except getopt.GetoptError as e:
+        sys.exit(f'{e}\n{__doc__}')
+    for opt, value in opts:
+        if opt == '-t':
+            prefix = value
+        elif opt == '-n':
+            top = int(value)
+        elif opt == '-l':
+            per = int(value)
+    if len(args) < 2:
+        sys.exit(__doc__)
+    elf, captures = args[0], args[1:]
+
+    counts, hz, shift, dropped = readDumps(captures)
+    if not counts:
+        sys.exit('no "#S" dumps in the captures, was the sketch built with the profiler?')
+    try:
+        functions = readFunctions(elf, prefix)
+        lines = readLines(elf, prefix, sorted(counts))
+    except (OSError, subprocess.CalledProcessError) as e:
+        sys.exit(f'{elf}: {e}')
+
+    total = sum(counts.values())
+    by_function = collections.Counter()
+    by_line = collections.defaultdict(collections.Counter)
+    for address, n in counts.items():
+        name = functionAt(functions, address)
+        by_function[name] += n
+        by_line[name][lines.get(address, '?')] += n
+
+    print(f'{total} samples at {hz} Hz, about {total / hz:.1f} s, {dropped} dropped'
+          + (f', every {2 << shift} bytes counted together' if shift else ''))
+    print()
+    print('flat')
+    print(f'{"self":>6} {"total":>6} {"samples":>8}  function')
+    running = 0
+    for name, n in by_function.most_common(top):
+        running += n
+        print(f'{100 * n / total:>5.1f}% {100 * running / total:>5.1f}% {n:>8}  {name}')
+
+    print()
+    print('per function')
+    for name, n in by_function.most_common(top):
+        print(f'{name}  {100 * n / total:.1f}%')
+        for line, m in by_line[name].most_common(per):
+            print(f'    {100 * m / n:>5.1f}% {m:>8}  {line}')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,260 @@
+/* Runs an input trace recorded from one of the task5 sketches back through the same sketch code
+ * built for the host, as fast as it will go, and writes out the timeline of what it did: every
+ * state change and every change to an output, stamped with the virtual time in ms.
+ *
+ * Usage: replay [options] device.so trace
+ *   -o file   write the timeline to file instead of stdout
+ *   -g file   compare the timeline to a golden one, exit 1 on any difference
+ *   -s file   save the trace as a raw trace file
+ *   -v        print the sketch's serial output to stderr
+ *
+ * The trace can be a serial capture of the sketch built with TRACE defined or a raw trace file.
+ * The sketch has to read its inputs in the same order it did when it was recorded, if it
+ * doesn't (the code changed which inputs it reads) the replay stops where it went different
+ * and exits 2.
+ *
+ * Times are only as exact as the trace: the clock is set to the recorded time at the start of
+ * every loop and only moves with delay() and pulseIn() within one.
+ */
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "sim/device.h"
+#include "sim/sim.h"
+#include "sim/trace.h"
+
+struct Replay {
+  SimDevice* device;
+  std::vector<TraceRecord> records;
+  size_t at = 0;
+  unsigned long loops = 0;
+  uint32_t last[32] = {};  // last value read from each pin
+  std::string diverged;    // why the sketch and the trace went different, empty if they haven't
+
+  std::vector<std::string> timeline;
+  std::map<int, uint32_t> outputs; // last value of every output, by kind and pin
+  int state = -1;
+  bool verbose = false;
+
+  unsigned long now() {
+    return *device->micros / 1000;
+  }
+
+  void event(const char* format, ...) {
+    char line[128];
+    int n = snprintf(line, sizeof(line), "%lu ", now());
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line + n, sizeof(line) - n, format, args);
+    va_end(args);
+    timeline.push_back(line);
+  }
+
+  void diverge(const char* read, uint8_t pin) {
+    if (!diverged.empty())
+      return;
+
+    char why[160];
+    if (at < records.size())
+      snprintf(why, sizeof(why), "in loop %lu at %lu ms the sketch read %s pin %d but the trace has %s pin %d",
+               loops, now(), read, pin, traceKindName(records[at].kind), records[at].pin);
+    else
+      snprintf(why, sizeof(why), "in loop %lu at %lu ms the sketch read %s pin %d after the trace ended",
+               loops, now(), read, pin);
+    diverged = why;
+  }
+
+  // The next recorded reading of a pin
+  uint32_t read(uint8_t kind, uint8_t pin) {
+    if (diverged.empty() && at < records.size() && records[at].pin == pin) {
+      const TraceRecord& r = records[at];
+      if (r.kind == kind) {
+        at++;
+        return last[pin] = r.value;
+      }
+      if (r.kind == TRACE_SAME) {
+        at++;
+        return last[pin];
+      }
+    }
+    diverge(traceKindName(kind), pin);
+    return 0;
+  }
+
+  char key() {
+    if (diverged.empty() && at < records.size()) {
+      const TraceRecord& r = records[at];
+      if (r.kind == TRACE_KEY || r.kind == TRACE_NO_KEY) {
+        at++;
+        return r.kind == TRACE_KEY ? r.value : 0;
+      }
+    }
+    diverge("the keypad", 0);
+    return 0;
+  }
+
+  void output(uint8_t kind, uint8_t pin, uint32_t value) {
+    static const char* names[] = {"digital", "analog", "servo", "pixels"};
+    int id = kind << 8 | pin;
+    std::map<int, uint32_t>::iterator last = outputs.find(id);
+    if (last != outputs.end() && last->second == value)
+      return;
+
+    outputs[id] = value;
+    if (kind == SIM_PIXELS)
+      event("%s %d %08x", names[kind], pin, value);
+    else
+      event("%s %d %u", names[kind], pin, value);
+  }
+
+  void checkState() {
+    int s = device->state();
+    if (s != state) {
+      state = s;
+      event("state %s", s >= 0 && s < device->num_states ? device->state_names[s] : "?");
+    }
+  }
+
+  // Returns false if the sketch and the trace went different
+  bool run() {
+    SimHooks hooks = {
+      this,
+      [](void* r, uint8_t pin) { return (int)((Replay*)r)->read(TRACE_ANALOG, pin); },
+      [](void* r, uint8_t pin) { return (int)((Replay*)r)->read(TRACE_DIGITAL, pin); },
+      [](void* r, uint8_t pin, uint8_t, unsigned long) { return (unsigned long)((Replay*)r)->read(TRACE_PULSE, pin); },
+      [](void* r) { return ((Replay*)r)->key(); },
+      [](void* r, uint8_t kind, uint8_t pin, uint32_t value) { ((Replay*)r)->output(kind, pin, value); },
+      [](void* r, const char* text, size_t len) { if (((Replay*)r)->verbose) fwrite(text, 1, len, stderr); },
+    };
+    *device->hooks = hooks;
+    *device->micros = 0;
+
+    device->setup();
+    checkState();
+
+    // a capture that started part way through a line has records from before its first loop
+    while (at < records.size() && records[at].kind != TRACE_LOOP)
+      at++;
+
+    uint64_t time = 0;
+    while (at < records.size() && diverged.empty()) {
+      const TraceRecord& r = records[at++];
+      if (r.kind != TRACE_LOOP) {
+        char why[160];
+        snprintf(why, sizeof(why), "loop %lu at %lu ms read less than the trace has, next is %s pin %d",
+                 loops, now(), traceKindName(r.kind), r.pin);
+        diverged = why;
+        break;
+      }
+
+      time += r.value * 1000ULL;
+      if (*device->micros < time)
+        *device->micros = time;
+
+      loops++;
+      device->loop();
+      checkState();
+    }
+
+    return diverged.empty();
+  }
+};
+
+bool readLines(const char* path, std::vector<std::string>& lines) {
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line))
+    lines.push_back(line);
+  return !in.bad() && (in.eof() || !lines.empty());
+}
+
+// Returns the number of lines that differ, printing the first few
+int compare(const std::vector<std::string>& golden, const std::vector<std::string>& timeline) {
+  int differences = 0;
+  size_t n = std::max(golden.size(), timeline.size());
+  for (size_t i = 0; i < n; i++) {
+    const char* want = i < golden.size() ? golden[i].c_str() : "(end)";
+    const char* got = i < timeline.size() ? timeline[i].c_str() : "(end)";
+    if (strcmp(want, got) == 0)
+      continue;
+
+    if (differences++ < 10)
+      fprintf(stderr, "line %zu: golden \"%s\", replay \"%s\"\n", i + 1, want, got);
+  }
+  return differences;
+}
+
+int main(int argc, char** argv) {
+  const char *out_path = nullptr, *golden_path = nullptr, *save_path = nullptr;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "o:g:s:v")) != -1) {
+    switch (opt) {
+    case 'o': out_path = optarg; break;
+    case 'g': golden_path = optarg; break;
+    case 's': save_path = optarg; break;
+    case 'v': verbose = true; break;
+    default: return 64;
+    }
+  }
+  if (argc - optind != 2) {
+    fprintf(stderr, "Usage: replay [-o timeline] [-g golden] [-s trace.trc] [-v] device.so trace\n");
+    return 64;
+  }
+
+  Replay replay;
+  replay.verbose = verbose;
+  if (!(replay.device = simLoad(argv[optind])))
+    return 1;
+  if (!traceLoad(argv[optind + 1], replay.records)) {
+    fprintf(stderr, "%s: can't read the trace\n", argv[optind + 1]);
+    return 1;
+  }
+  if (save_path && !traceSave(save_path, replay.records)) {
+    fprintf(stderr, "%s: can't write the trace\n", save_path);
+    return 1;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool same = replay.run();
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  fprintf(stderr, "%s: %lu loops, %.1f s of device time in %.3f s (%.0f loops/s)\n",
+          replay.device->name, replay.loops, replay.now() / 1000.0, wall, replay.loops / std::max(wall, 1e-9));
+
+  if (out_path) {
+    std::ofstream out(out_path);
+    for (size_t i = 0; i < replay.timeline.size(); i++)
+      out << replay.timeline[i] << '\n';
+  } else if (!golden_path) {
+    for (size_t i = 0; i < replay.timeline.size(); i++)
+      printf("%s\n", replay.timeline[i].c_str());
+  }
+
+  if (!same) {
+    fprintf(stderr, "trace diverged: %s\n", replay.diverged.c_str());
+    return 2;
+  }
+
+  if (golden_path) {
+    std::vector<std::string> golden;
+    if (!readLines(golden_path, golden)) {
+      fprintf(stderr, "%s: can't read the golden timeline\n", golden_path);
+      return 1;
+    }
+    int differences = compare(golden, replay.timeline);
+    if (differences) {
+      fprintf(stderr, "%d lines differ from %s\n", differences, golden_path);
+      return 1;
+    }
+    fprintf(stderr, "matches %s\n", golden_path);
+  }
+  return 0;
+}
@@ -0,0 +1,13 @@
+#!/usr/bin/bash
+
+# log_decode, replay and fleet
+alias compile='mkdir -p bin && g++ -std=c++11 -O2 -Wall -o bin/log_decode log_decode.cpp && g++ -std=c++11 -O2 -Wall -o bin/replay replay.cpp -ldl && g++ -std=c++11 -O2 -Wall -pthread -o bin/fleet fleet.cpp -ldl'
+
+# The task5 sketches as device libraries for replay and fleet: bin/lock.so, bin/sensor.so and bin/microwave.so
+alias devices='mkdir -p bin/gen && for d in 5.2:lock 5.3:sensor 5.4:microwave; do python3 sim/prototypes.py ../task5/${d%%:*}.cpp > bin/gen/${d%%:*}.cpp && g++ -std=c++11 -O2 -shared -fPIC -fvisibility=hidden -DTRACE -Wno-write-strings -Isim -Ibin/gen $(printf -- "-I%s " ../libraries/*) -o bin/${d#*:}.so devices/${d#*:}.cpp sim/sim.cpp || break; done'
+
+# The fuzzer and the task5 sketches built for it, with coverage and without TRACE or debug messages: bin/fuzz/lock.so etc.
+alias fuzzers='mkdir -p bin/gen bin/fuzz && g++ -std=c++11 -O2 -Wall -rdynamic -o bin/fuzz/fuzz fuzz.cpp -ldl && for d in 5.2:lock 5.3:sensor 5.4:microwave; do python3 sim/prototypes.py ../task5/${d%%:*}.cpp > bin/gen/${d%%:*}.cpp && g++ -std=c++11 -O2 -shared -fPIC -fvisibility=hidden -fsanitize-coverage=trace-pc -DNO_DEBUG -Wno-write-strings -Isim -Ibin/gen $(printf -- "-I%s " ../libraries/*) -o bin/fuzz/${d#*:}.so devices/${d#*:}.cpp sim/sim.cpp || break; done'
+
+# The task5 sketches with the libraries they include put in, one file each for Tinkercad: bin/tinkercad/5.2.cpp etc.
+alias tinkercad='mkdir -p bin/tinkercad && for s in 5.2 5.3 5.4; do python3 bundle.py ../task5/$s.cpp > bin/tinkercad/$s.cpp || break; done'
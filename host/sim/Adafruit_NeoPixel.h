@@ -0,0 +1,52 @@
+// NeoPixel library shim, every show() is reported as a SIM_PIXELS output
+#ifndef SIM_ADAFRUIT_NEOPIXEL_H
+#define SIM_ADAFRUIT_NEOPIXEL_H
+
+#include "Arduino.h"
+
+#define NEO_GRB 0x52
+#define NEO_RGB 0x06
+#define NEO_KHZ800 0x0000
+#define SIM_MAX_PIXELS 64
+
+class Adafruit_NeoPixel {
+public:
+  Adafruit_NeoPixel(uint16_t n, uint8_t pin, uint16_t type) : n(min(n, SIM_MAX_PIXELS)), pin(pin) {
+    (void)type;
+    memset(pixels, 0, sizeof(pixels));
+  }
+
+  void begin() {}
+  void setBrightness(uint8_t) {}
+  uint16_t numPixels() { return n; }
+
+  void setPixelColor(uint16_t i, uint32_t colour) {
+    if (i < n)
+      pixels[i] = colour;
+  }
+
+  uint32_t getPixelColor(uint16_t i) { return i < n ? pixels[i] : 0; }
+
+  void clear() { memset(pixels, 0, sizeof(pixels)); }
+
+  // FNV-1a over every colour
+  void show() {
+    uint32_t hash = 2166136261u;
+    for (uint16_t i = 0; i < n; i++) {
+      for (int b = 0; b < 24; b += 8)
+        hash = (hash ^ ((pixels[i] >> b) & 0xff)) * 16777619u;
+    }
+    simOutput(SIM_PIXELS, pin, hash);
+  }
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return (uint32_t)r << 16 | (uint32_t)g << 8 | b;
+  }
+
+private:
+  uint16_t n;
+  uint8_t pin;
+  uint32_t pixels[SIM_MAX_PIXELS];
+};
+
+#endif // SIM_ADAFRUIT_NEOPIXEL_H
@@ -0,0 +1,188 @@
+/* Just enough of the Arduino core for the task5 sketches to build and run on the host.
+ * See sim.h for how the inputs and outputs are hooked up.
+ *
+ * Unlike an Uno, int is 32 bits and long is 64 bits here, so code that relies on 16 bit
+ * overflow won't behave the same.
+ */
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// everything from the standard library comes in before the Arduino macros below can break it
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "sim.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define E2END 0x3ff // last EEPROM address, an Uno's
+
+// Nothing interrupts the sketch here, so saving the status register and turning interrupts off
+// and on again do nothing
+static uint8_t SREG __attribute__((unused));
+inline void cli() {}
+inline void sei() {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// Flash and RAM are the same thing here, so flash strings are plain strings behind the same types
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper*)(s))
+#define PSTR(s) (s)
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_ptr(p) (*(void* const*)(p))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strcpy_P strcpy
+#define memcpy_P memcpy
+
+extern SimHooks sim_hooks;
+extern uint64_t sim_micros;
+extern uint8_t sim_pins[SIM_PINS]; // what every pin was last written, level or duty
+extern uint8_t sim_inputs[SIM_PINS]; // the level every pin was last read at
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+unsigned long pulseIn(uint8_t pin, uint8_t level, unsigned long timeout=1000000L);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+void simOutput(uint8_t kind, uint8_t pin, uint32_t value);
+
+
+class String {
+public:
+  String() {}
+  String(const char* s) : s(s ? s : "") {}
+  String(const std::string& s) : s(s) {}
+  String(const __FlashStringHelper* s) : String((const char*)s) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(int value, unsigned char base=10);
+  explicit String(unsigned int value, unsigned char base=10);
+  explicit String(long value, unsigned char base=10);
+  explicit String(unsigned long value, unsigned char base=10);
+  explicit String(double value, unsigned char decimals=2);
+
+  unsigned int length() const { return s.size(); }
+  const char* c_str() const { return s.c_str(); }
+
+  bool concat(const String& other) { s += other.s; return true; }
+  bool concat(const char* other) { s += other; return true; }
+  bool concat(char c) { s += c; return true; }
+  bool concat(int value) { return concat(String(value)); }
+
+  String& operator+=(const String& other) { concat(other); return *this; }
+  String& operator+=(const char* other) { concat(other); return *this; }
+  String& operator+=(char c) { concat(c); return *this; }
+
+  friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+  friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+  friend String operator+(const String& a, const __FlashStringHelper* b) { return String(a.s + (const char*)b); }
+  friend String operator+(const String& a, char b) { return String(a.s + b); }
+  friend String operator+(const String& a, int b) { return a + String(b); }
+  friend String operator+(const String& a, long b) { return a + String(b); }
+  friend String operator+(const String& a, unsigned long b) { return a + String(b); }
+  friend String operator+(const String& a, double b) { return a + String(b); }
+
+  bool operator==(const String& other) const { return s == other.s; }
+  bool operator==(const char* other) const { return s == other; }
+  bool operator!=(const String& other) const { return s != other.s; }
+  bool operator!=(const char* other) const { return s != other; }
+
+private:
+  std::string s;
+};
+
+
+class Print {
+public:
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* data, size_t len);
+
+  size_t print(const char* s);
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t print(const __FlashStringHelper* s) { return print((const char*)s); }
+  size_t print(char c) { return write(c); }
+  size_t print(unsigned char value, int base=DEC) { return print((unsigned long)value, base); }
+  size_t print(int value, int base=DEC) { return print((long)value, base); }
+  size_t print(unsigned int value, int base=DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base=DEC);
+  size_t print(unsigned long value, int base=DEC);
+  size_t print(double value, int decimals=2);
+
+  size_t println() { return print("\r\n"); }
+  template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+  template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+};
+
+// Nothing is ever typed in, a replay's inputs come from its trace instead
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  int available() { return 0; }
+  int read() { return -1; }
+  operator bool() { return true; }
+  using Print::write;
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* data, size_t len);
+};
+
+extern HardwareSerial Serial;
+
+// Every device library exports one of these. `state` is the variable holding the state
+// machine's state, `names` the array of its names and `check` a function that returns null if
+// the device's invariants hold or what broke if they don't, or nullptr for no checks.
+// `regressions` lists inputs that broke the checks once, as hex in fuzz's format and ending in
+// nullptr, or is nullptr for none.
+#define SIM_DEVICE(name, state, names, check, regressions) \
+  static int simState() { return (int)(state); } \
+  extern "C" __attribute__((visibility("default"))) SimDevice* sim_device() { \
+    static SimDevice device = { \
+      name, &sim_hooks, &sim_micros, setup, loop, simState, \
+      (const char* const*)names, (int)(sizeof(names) / sizeof(names[0])), check, regressions \
+    }; \
+    return &device; \
+  }
+
+#endif // SIM_ARDUINO_H
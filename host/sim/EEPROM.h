@@ -0,0 +1,22 @@
+// EEPROM library shim, an Uno's 1 KB starting blank
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include "Arduino.h"
+
+class EEPROMClass {
+public:
+  uint8_t read(int address) { return data[address]; }
+  void write(int address, uint8_t value) { data[address] = value; }
+  void update(int address, uint8_t value) { data[address] = value; }
+  uint8_t& operator[](int address) { return data[address]; }
+  uint16_t length() { return sizeof(data); }
+
+  uint8_t data[1024];
+
+  EEPROMClass() { memset(data, 0xff, sizeof(data)); }
+};
+
+static EEPROMClass EEPROM;
+
+#endif // SIM_EEPROM_H
@@ -0,0 +1,19 @@
+// Keypad library shim, key presses come from SimHooks::get_key
+#ifndef SIM_KEYPAD_H
+#define SIM_KEYPAD_H
+
+#include "Arduino.h"
+
+#define NO_KEY '\0'
+#define makeKeymap(x) ((char*)x)
+
+class Keypad {
+public:
+  Keypad(char*, byte*, byte*, byte, byte) {}
+
+  char getKey() {
+    return sim_hooks.get_key ? sim_hooks.get_key(sim_hooks.ctx) : NO_KEY;
+  }
+};
+
+#endif // SIM_KEYPAD_H
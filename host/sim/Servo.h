@@ -0,0 +1,25 @@
+// Servo library shim, every write is reported as a SIM_SERVO output
+#ifndef SIM_SERVO_H
+#define SIM_SERVO_H
+
+#include "Arduino.h"
+
+class Servo {
+public:
+  uint8_t attach(int pin) { this->pin = pin; return 0; }
+  void detach() {}
+  bool attached() { return true; }
+
+  void write(int value) {
+    angle = constrain(value, 0, 180);
+    simOutput(SIM_SERVO, pin, angle);
+  }
+
+  int read() { return angle; }
+
+private:
+  int pin = 0;
+  int angle = 90;
+};
+
+#endif // SIM_SERVO_H
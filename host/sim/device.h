@@ -0,0 +1,30 @@
+// Loading the device libraries built from the sketches, see sim.h
+#ifndef SIM_DEVICE_H
+#define SIM_DEVICE_H
+
+#include <dlfcn.h>
+#include <cstdio>
+
+#include "sim.h"
+
+// Load a device library, returns null and prints why if it can't be
+inline SimDevice* simLoad(const char* path, void** handle=nullptr) {
+  void* lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (!lib) {
+    fprintf(stderr, "%s\n", dlerror());
+    return nullptr;
+  }
+
+  SimDeviceFunc device = (SimDeviceFunc)dlsym(lib, SIM_DEVICE_FUNC);
+  if (!device) {
+    fprintf(stderr, "%s: not a device library, no %s()\n", path, SIM_DEVICE_FUNC);
+    dlclose(lib);
+    return nullptr;
+  }
+
+  if (handle)
+    *handle = lib;
+  return device();
+}
+
+#endif // SIM_DEVICE_H
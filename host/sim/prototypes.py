@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Adds the function prototypes the Arduino IDE (and Tinkercad) would generate to a sketch so it
+can be compiled as plain C++, the same way: one for every top level function, all placed just
+before the first function definition. Functions in a header that bundle.py put in the sketch,
+after a #line naming the header, are left alone, the same as in one that's included.
+
+Usage: prototypes.py sketch.cpp > sketch_with_prototypes.cpp
+"""
+import re
+import sys
+
+
+def blank(match):
+    return re.sub(r'[^\n]', ' ', match.group(0))
+
+
+def main(path):
+    src = open(path).read()
+
+    # blank out comments and strings so they can't look like code, keeping every offset
+    code = re.sub(r'//[^\n]*', blank, src)
+    code = re.sub(r'/\*.*?\*/', blank, code, flags=re.S)
+    code = re.sub(r'"(\\.|[^"\\])*"', blank, code)
+    code = re.sub(r"'(\\.|[^'\\])'", blank, code)
+
+    depth = [0] * (len(code) + 1)
+    d = 0
+    for i, c in enumerate(code):
+        depth[i] = d
+        if c == '{':
+            d += 1
+        elif c == '}':
+            d -= 1
+
+    # the file every offset is in as far as #line says, None for the sketch
+    header = [None] * (len(code) + 1)
+    at = 0
+    current = None
+    for m in re.finditer(r'(?m)^#line\s+(\d+)\s+"([^"]*)"', src):
+        header[at:m.start()] = [current] * (m.start() - at)
+        at = m.start()
+        current = m.group(2) if m.group(2).endswith('.h') else None
+    header[at:] = [current] * (len(header) - at)
+
+    prototypes = []
+    first = None
+    definition = re.compile(r'(?m)^([A-Za-z_][\w:<>\*& ]*?[\s\*&]+)([A-Za-z_]\w*)\s*'
+                            r'\(([^;{}()]*(?:\([^()]*\)[^;{}()]*)*)\)\s*(?:const\s*)?\{')
+    for m in definition.finditer(code):
+        kind, name, args = m.group(1).strip(), m.group(2), m.group(3)
+        if depth[m.start()] != 0 or header[m.start()] or name in ('if', 'while', 'for', 'switch', 'ISR'):
+            continue
+        if kind in ('return', 'else', 'struct', 'class', 'namespace', 'enum'):
+            continue
+        if re.search(r'template\s*<[^;{}]*$', code[max(0, m.start() - 200):m.start()]):
+            continue
+        args = re.sub(r'=[^,]*', '', args)
+        prototypes.append(f'{m.group(1)}{name}({args.strip()});')
+        if first is None:
+            first = m.start()
+
+    if first is None:
+        first = len(src)
+    line = src[:first].count('\n')
+    lines = src.split('\n')
+
+    # where the sketch goes on from, after any #line before it
+    resume, file = line + 1, path
+    for m in re.finditer(r'(?m)^#line\s+(\d+)\s+"([^"]*)"', src[:first]):
+        resume = int(m.group(1)) + line - src[:m.start()].count('\n') - 1
+        file = m.group(2)
+
+    out = sys.stdout
+    out.write('#include <Arduino.h>\n')
+    out.write(f'#line 1 "{path}"\n')
+    out.write('\n'.join(lines[:line]) + '\n')
+    out.write('\n'.join(prototypes) + '\n')
+    out.write(f'#line {resume} "{file}"\n')
+    out.write('\n'.join(lines[line:]))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1])
@@ -0,0 +1,133 @@
+// The Arduino core functions declared in Arduino.h, built into every device library
+#include "Arduino.h"
+
+#include <stdio.h>
+
+SimHooks sim_hooks;
+uint64_t sim_micros = 0;
+uint8_t sim_pins[SIM_PINS];
+uint8_t sim_inputs[SIM_PINS];
+HardwareSerial Serial;
+
+
+unsigned long millis() {
+  return sim_micros / 1000;
+}
+
+unsigned long micros() {
+  return sim_micros;
+}
+
+void delay(unsigned long ms) {
+  sim_micros += ms * 1000ULL;
+}
+
+void delayMicroseconds(unsigned int us) {
+  sim_micros += us;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void simOutput(uint8_t kind, uint8_t pin, uint32_t value) {
+  if (sim_hooks.output)
+    sim_hooks.output(sim_hooks.ctx, kind, pin, value);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < SIM_PINS)
+    sim_pins[pin] = value ? HIGH : LOW;
+  simOutput(SIM_DIGITAL, pin, value ? HIGH : LOW);
+}
+
+void analogWrite(uint8_t pin, int value) {
+  if (pin < SIM_PINS)
+    sim_pins[pin] = value;
+  simOutput(SIM_ANALOG, pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+  int level = sim_hooks.digital_read ? sim_hooks.digital_read(sim_hooks.ctx, pin) : LOW;
+  if (pin < SIM_PINS)
+    sim_inputs[pin] = level ? HIGH : LOW;
+  return level;
+}
+
+int analogRead(uint8_t pin) {
+  return sim_hooks.analog_read ? sim_hooks.analog_read(sim_hooks.ctx, pin) : 0;
+}
+
+// Takes as long as the pulse, or the timeout if there wasn't one
+unsigned long pulseIn(uint8_t pin, uint8_t level, unsigned long timeout) {
+  unsigned long time = sim_hooks.pulse_in ? sim_hooks.pulse_in(sim_hooks.ctx, pin, level, timeout) : 0;
+  sim_micros += time ? time : timeout;
+  return time;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+
+// Numbers are formatted the same way the Arduino core does
+static std::string formatNumber(unsigned long value, unsigned char base, bool negative) {
+  char buffer[8 * sizeof(long) + 2];
+  char* p = buffer + sizeof(buffer) - 1;
+  *p = '\0';
+  if (base < 2)
+    base = 10;
+  do {
+    int digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value);
+  if (negative)
+    *--p = '-';
+  return p;
+}
+
+static std::string formatFloat(double value, unsigned char decimals) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  return buffer;
+}
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+String::String(long value, unsigned char base)
+  : s(base == 10 && value < 0 ? formatNumber(-(unsigned long)value, 10, true) : formatNumber(value, base, false)) {}
+String::String(unsigned long value, unsigned char base) : s(formatNumber(value, base, false)) {}
+String::String(double value, unsigned char decimals) : s(formatFloat(value, decimals)) {}
+
+
+size_t Print::write(const uint8_t* data, size_t len) {
+  size_t n = 0;
+  while (len--)
+    n += write(*data++);
+  return n;
+}
+
+size_t Print::print(const char* s) {
+  return write((const uint8_t*)s, strlen(s));
+}
+
+size_t Print::print(long value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(double value, int decimals) {
+  return print(String(value, decimals));
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t len) {
+  if (sim_hooks.serial)
+    sim_hooks.serial(sim_hooks.ctx, (const char*)data, len);
+  return len;
+}
@@ -0,0 +1,53 @@
+/* The interface between a sketch built for the host and the tools that drive it.
+ *
+ * A sketch is compiled together with the shim headers in this folder (Arduino.h, Keypad.h,
+ * Servo.h, ...) into a shared library. Everything it reads goes through SimHooks and everything
+ * it drives is reported to SimHooks::output, against a virtual clock that only moves when the
+ * sketch delays or the tool moves it. All of a device's state, the shim's included, lives in
+ * its library's globals, so every copy of the library that is loaded is an independent device.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Outputs reported to SimHooks::output
+enum SimOutput {
+  SIM_DIGITAL, // digitalWrite(), value is the level
+  SIM_ANALOG,  // analogWrite(), value is the duty
+  SIM_SERVO,   // Servo::write(), value is the angle
+  SIM_PIXELS,  // Adafruit_NeoPixel::show(), value is a hash of every pixel's colour
+};
+
+#define SIM_PINS 20 // digital pins 0-13 and A0-A5
+
+// Any hook can be left null, inputs then read as 0 and outputs go nowhere
+struct SimHooks {
+  void* ctx;
+  int (*analog_read)(void* ctx, uint8_t pin);
+  int (*digital_read)(void* ctx, uint8_t pin);
+  unsigned long (*pulse_in)(void* ctx, uint8_t pin, uint8_t level, unsigned long timeout);
+  char (*get_key)(void* ctx);
+  void (*output)(void* ctx, uint8_t kind, uint8_t pin, uint32_t value);
+  void (*serial)(void* ctx, const char* text, size_t len);
+};
+
+struct SimDevice {
+  const char* name;
+  SimHooks* hooks;
+  uint64_t* micros;               // the virtual clock
+  void (*setup)();
+  void (*loop)();
+  int (*state)();                 // the state machine's current state
+  const char* const* state_names;
+  int num_states;
+  const char* (*check)();         // null if every invariant holds, else what broke, may be null
+  const char* const* regressions; // inputs that once broke check, see fuzz.cpp, may be null
+};
+
+// Every device library exports this, see SIM_DEVICE()
+typedef SimDevice* (*SimDeviceFunc)();
+#define SIM_DEVICE_FUNC "sim_device"
+
+#endif // SIM_H
@@ -0,0 +1,75 @@
+/* Saving and restoring every global of a loaded device library, which is all of the device's
+ * state, so one loaded copy can be reset to power on (or any saved point) with a memcpy
+ * instead of a dlclose and dlopen.
+ *
+ * The globals are the library's writable load segment less the part the loader makes read only
+ * after relocating (RELRO). A device that keeps state anywhere else, like memory it allocated
+ * and is still holding between loops, can't be snapshotted this way.
+ */
+#ifndef SIM_SNAPSHOT_H
+#define SIM_SNAPSHOT_H
+
+#include <dlfcn.h>
+#include <link.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct SimSnapshot {
+  uint8_t* start = nullptr; // the library's globals
+  size_t size = 0;
+  std::vector<uint8_t> data;
+
+  // Find the globals of a library from dlopen() and save them
+  bool take(void* handle) {
+    struct link_map* map;
+    if (dlinfo(handle, RTLD_DI_LINKMAP, &map) != 0)
+      return false;
+
+    struct Search {
+      ElfW(Addr) base;
+      uintptr_t start, end;
+    } search = {map->l_addr, 0, 0};
+
+    dl_iterate_phdr([](struct dl_phdr_info* info, size_t, void* arg) {
+      Search* s = (Search*)arg;
+      if (info->dlpi_addr != s->base)
+        return 0;
+
+      uintptr_t page = sysconf(_SC_PAGESIZE);
+      uintptr_t relro_end = 0;
+      for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+        if (ph.p_type == PT_LOAD && (ph.p_flags & PF_W)) {
+          s->start = info->dlpi_addr + ph.p_vaddr;
+          s->end = s->start + ph.p_memsz;
+        } else if (ph.p_type == PT_GNU_RELRO) {
+          // the loader only protects whole pages
+          relro_end = (info->dlpi_addr + ph.p_vaddr + ph.p_memsz) & ~(page - 1);
+        }
+      }
+      if (relro_end > s->start && relro_end <= s->end)
+        s->start = relro_end;
+      return 1;
+    }, &search);
+
+    if (search.end <= search.start)
+      return false;
+
+    start = (uint8_t*)search.start;
+    size = search.end - search.start;
+    save();
+    return true;
+  }
+
+  void save() {
+    data.assign(start, start + size);
+  }
+
+  void restore() const {
+    memcpy(start, data.data(), size);
+  }
+};
+
+#endif // SIM_SNAPSHOT_H
@@ -0,0 +1,128 @@
+/* Reading and writing the input traces the task5 sketches print when built with TRACE.
+ *
+ * A trace is a run of records, each a tag byte (kind in the top 3 bits, pin in the bottom 5)
+ * followed by a varint value for the kinds that have one. The sketches print them as "#T <hex>"
+ * lines among their other serial output, a trace file is the same records as raw bytes.
+ * The kinds have to match the TRACE_* defines in libraries/InputTrace/InputTrace.h.
+ */
+#ifndef SIM_TRACE_H
+#define SIM_TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum TraceKind {
+  TRACE_LOOP = 0,    // start of a loop, value is ms since the last one
+  TRACE_KEY = 1,     // a key press, value is the key
+  TRACE_NO_KEY = 2,  // no key pressed
+  TRACE_ANALOG = 3,  // analogRead()
+  TRACE_DIGITAL = 4, // digitalRead()
+  TRACE_PULSE = 5,   // pulseIn(), us
+  TRACE_SAME = 6,    // the pin read the same as last time
+};
+
+struct TraceRecord {
+  uint8_t kind;
+  uint8_t pin;
+  uint32_t value;
+};
+
+inline bool traceHasValue(uint8_t kind) {
+  return kind != TRACE_NO_KEY && kind != TRACE_SAME;
+}
+
+inline const char* traceKindName(uint8_t kind) {
+  static const char* names[] = {"loop", "key", "no key", "analog", "digital", "pulse", "same", "?"};
+  return names[kind & 7];
+}
+
+// Decode raw trace bytes, returns false if they end part way through a record
+inline bool traceDecode(const std::vector<uint8_t>& bytes, std::vector<TraceRecord>& out) {
+  size_t at = 0;
+  while (at < bytes.size()) {
+    TraceRecord r = {uint8_t(bytes[at] >> 5), uint8_t(bytes[at] & 0x1f), 0};
+    at++;
+
+    if (traceHasValue(r.kind)) {
+      bool done = false;
+      for (int shift = 0; at < bytes.size() && shift < 35 && !done; shift += 7) {
+        r.value |= uint32_t(bytes[at] & 0x7f) << shift;
+        done = !(bytes[at++] & 0x80);
+      }
+      if (!done)
+        return false;
+    }
+    out.push_back(r);
+  }
+  return true;
+}
+
+inline void traceEncode(const TraceRecord& r, std::vector<uint8_t>& out) {
+  out.push_back(r.kind << 5 | (r.pin & 0x1f));
+  if (traceHasValue(r.kind)) {
+    uint32_t value = r.value;
+    while (value >= 0x80) {
+      out.push_back(value | 0x80);
+      value >>= 7;
+    }
+    out.push_back(value);
+  }
+}
+
+// Pull the trace out of the "#T <hex>" lines of a serial capture, skipping everything else
+inline void traceFromCapture(const std::string& capture, std::vector<uint8_t>& out) {
+  size_t at = 0;
+  while (at < capture.size()) {
+    size_t end = capture.find('\n', at);
+    if (end == std::string::npos)
+      end = capture.size();
+
+    if (capture.compare(at, 3, "#T ") == 0) {
+      for (size_t i = at + 3; i + 1 < end; i += 2) {
+        unsigned int byte;
+        if (sscanf(capture.c_str() + i, "%2x", &byte) != 1)
+          break;
+        out.push_back(byte);
+      }
+    }
+    at = end + 1;
+  }
+}
+
+// Load a trace file, either raw records or a serial capture. Raw traces always start with a
+// loop record, which is a 0 byte, and a capture never does.
+inline bool traceLoad(const char* path, std::vector<TraceRecord>& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return false;
+
+  std::string data;
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    data.append(buffer, n);
+  fclose(f);
+
+  std::vector<uint8_t> bytes;
+  if (!data.empty() && data[0] == 0)
+    bytes.assign(data.begin(), data.end());
+  else
+    traceFromCapture(data, bytes);
+  return traceDecode(bytes, out);
+}
+
+inline bool traceSave(const char* path, const std::vector<TraceRecord>& records) {
+  std::vector<uint8_t> bytes;
+  for (size_t i = 0; i < records.size(); i++)
+    traceEncode(records[i], bytes);
+
+  FILE* f = fopen(path, "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+  return fclose(f) == 0 && ok;
+}
+
+#endif // SIM_TRACE_H
@@ -0,0 +1,343 @@
+/* The climate display's readings, pages and remote, shared by task4.4 and multiapp's climate app.
+ *
+ * A DHT11 is read into ClimateStats.h's statistics and SensorLog.h's EEPROM log, and a 16x2 LCD
+ * pages through the readings, the range and trend of each statistics window and a status page.
+ * Its contrast follows a pot, trimmed from an IR remote that also turns the display off and
+ * pages it. How often the display, contrast and log are updated are settings (see
+ * ConfigStore.h).
+ *
+ * The sketch owns the board and the scheduling, the library does the rest:
+ *
+ *   constexpr ConfigParam CONFIG[] PROGMEM = {CLIMATE_CONFIG};        // plus any of its own
+ *   climateBegin(lcd, dht, 6, A0);                                    // in setup(), contrast out and pot
+ *   climateIRBegin(3);
+ *   climateSchedule(wheelEvery);                                      // or appEvery, for the jobs
+ *   climateIRDispatch();                                              // every pass of the loop
+ *
+ * Presses are queued by the receiver's interrupt, CLIMATE_IR_QUEUE of them, and acted on by
+ * climateIRDispatch(). A frame that doesn't decode to a known protocol isn't queued. Messages are
+ * "<CLIMATE_NAME><message>". Define LOG_PAGES before including this to size the log.
+ */
+#ifndef CLIMATEDISPLAY_H
+#define CLIMATEDISPLAY_H
+
+#include <Arduino.h>
+#include <DHT.h>
+#include <DHT_U.h>
+#include <Adafruit_Sensor.h>
+#include <IRremote.h>
+#include <Adafruit_LiquidCrystal.h>
+#include <TimingWheel.h>
+#include <ConfigStore.h>
+#include <ClimateStats.h>
+#include <SensorLog.h>
+#include <DialMap.h>
+
+#ifndef CLIMATE_NAME
+#define CLIMATE_NAME ""            // in front of every message, "climate: " say
+#endif
+#ifndef CLIMATE_IR_QUEUE
+#define CLIMATE_IR_QUEUE 8         // decoded presses that can be waiting, a power of 2
+#endif
+#define CLIMATE_CONTRAST_STEP 8    // contrast change per contrast up/down press (or repeat)
+#define CLIMATE_PAGES (2 + 2 * STATS_WINDOWS) // readings, range and trend of each window, status
+
+static_assert((CLIMATE_IR_QUEUE & (CLIMATE_IR_QUEUE - 1)) == 0, "CLIMATE_IR_QUEUE has to be a power of 2");
+
+// Settings
+unsigned long lcd_update_interval = 2000;
+unsigned long lcd_contrast_update_interval = 400;
+unsigned long log_interval = 60000; // save the readings to the EEPROM log every this many ms
+void climateIntervalsChanged();
+#define CLIMATE_CONFIG \
+  {"lcd_ms", CONFIG_U32, &lcd_update_interval, 100, 60000, climateIntervalsChanged}, \
+  {"contrast_ms", CONFIG_U32, &lcd_contrast_update_interval, 50, 10000, climateIntervalsChanged}, \
+  {"log_ms", CONFIG_U32, &log_interval, 1000, 3600000, climateIntervalsChanged}
+
+// A press as captured by the receive interrupt
+struct ClimatePress {
+  uint16_t command;
+  uint8_t flags;      // IRDATA_FLAGS_IS_REPEAT etc. from the decoder
+  unsigned long time; // micros() when the frame finished decoding
+};
+
+// Schedules a job every `period` ms, wheelEvery() or multiapp's appEvery()
+typedef int8_t (*ClimateEvery)(const char* name, void (*callback)(), unsigned long period);
+
+Adafruit_LiquidCrystal* climate_lcd;
+DHT_Unified* climate_dht;
+uint8_t climate_contrast_pin, climate_contrast_input;
+double climate_humidity, climate_temperature;
+bool climate_read = false;         // whether humidity and temperature have been read yet
+volatile ClimatePress climate_ir_queue[CLIMATE_IR_QUEUE];
+volatile uint8_t climate_ir_head = 0, climate_ir_tail = 0; // written by the ISR, read by climateIRDispatch()
+volatile uint8_t climate_ir_dropped = 0;                   // presses lost because the queue was full
+uint16_t climate_last_command = 0; // command a repeat code refers to
+bool climate_lcd_on = true;
+byte climate_contrast = 0;
+int climate_contrast_offset = 0;   // adjustment on top of the potentiometer from the IR remote
+byte climate_page = 0;             // which page of information is on the display
+int8_t climate_lcd_job = WHEEL_NONE, climate_contrast_job = WHEEL_NONE, climate_log_job = WHEEL_NONE;
+
+
+// Take the LCD, DHT and contrast pins and start them, call from setup()
+void climateBegin(Adafruit_LiquidCrystal& lcd, DHT_Unified& dht, uint8_t contrast_pin, uint8_t contrast_input) {
+  climate_lcd = &lcd;
+  climate_dht = &dht;
+  climate_contrast_pin = contrast_pin;
+  climate_contrast_input = contrast_input;
+
+  pinMode(contrast_pin, OUTPUT);
+  pinMode(contrast_input, INPUT);
+  lcd.begin(16, 2);
+  lcd.noBlink();
+  lcd.noCursor();
+
+  dht.begin();
+  statsBegin(millis());
+  logBegin();
+}
+
+void climateContrastUpdate() {
+  climate_contrast = constrain(DIAL_LINEAR(0, 255, analogRead(climate_contrast_input)) + climate_contrast_offset, 0, 255);
+  analogWrite(climate_contrast_pin, climate_contrast);
+}
+
+// Clear a row of the display and start writing at its left
+void climateRow(byte row) {
+  climate_lcd->setCursor(0, row);
+  climate_lcd->print(F("                "));
+  climate_lcd->setCursor(0, row);
+}
+
+// Writes one quantity's range (low-high) or trend (mean and change per hour) over a window to a row of the display
+void climateStatsRow(byte row, char label, StatsWindow& window, byte quantity, bool trend) {
+  climateRow(row);
+  // the window name goes in the last 2 columns of the top row, a long value is cut short before it
+  ClippedPrint field(*climate_lcd, row == 0 ? 13 : 16);
+  field.print(label);
+  field.print(' ');
+
+  if (trend) {
+    printTenths(field, statsMean(window, quantity));
+    field.print(' ');
+    int16_t rate = statsRate(window, quantity);
+    if (rate >= 0)
+      field.print('+');
+    printTenths(field, rate);
+    field.print(F("/h"));
+  } else {
+    printTenths(field, statsLow(window, quantity));
+    field.print('-');
+    printTenths(field, statsHigh(window, quantity));
+  }
+
+  if (row == 0) {
+    climate_lcd->setCursor(14, 0);
+    climate_lcd->print(window.name);
+  }
+}
+
+// Writes the current page out to the display
+void climateLCDUpdate() {
+  if (climate_page == 0) {
+    climateRow(0);
+    climate_lcd->print(F("Humid "));
+    climate_lcd->print(climate_humidity);
+    climateRow(1);
+    climate_lcd->print(F("Temp "));
+    climate_lcd->print(climate_temperature);
+  } else if (climate_page == CLIMATE_PAGES - 1) {
+    climateRow(0);
+    climate_lcd->print(F("Contrast "));
+    climate_lcd->print(climate_contrast);
+    climateRow(1);
+    climate_lcd->print(F("IR dropped "));
+    climate_lcd->print(climate_ir_dropped);
+  } else {
+    StatsWindow& window = stats_windows[(climate_page - 1) / 2];
+    bool trend = (climate_page - 1) % 2;
+    climateStatsRow(0, 'H', window, STATS_HUMIDITY, trend);
+    climateStatsRow(1, 'T', window, STATS_TEMPERATURE, trend);
+  }
+}
+
+// show the next page of information
+void climateNextPage() {
+  climate_page = (climate_page + 1) % CLIMATE_PAGES;
+  climateLCDUpdate();
+}
+
+// show the previous page of information
+void climatePrevPage() {
+  climate_page = (climate_page + CLIMATE_PAGES - 1) % CLIMATE_PAGES;
+  climateLCDUpdate();
+}
+
+void climateContrastUp() {
+  climate_contrast_offset = min(climate_contrast_offset + CLIMATE_CONTRAST_STEP, 255);
+  climateContrastUpdate();
+}
+
+void climateContrastDown() {
+  climate_contrast_offset = max(climate_contrast_offset - CLIMATE_CONTRAST_STEP, -255);
+  climateContrastUpdate();
+}
+
+// turns on or off the LCD display (doesn't turn off the backlight)
+void climateToggleLCD() {
+  if (climate_lcd_on)
+    climate_lcd->noDisplay();
+  else
+    climate_lcd->display();
+  climate_lcd_on = !climate_lcd_on;
+}
+
+// Reads the humidity and temperature and adds them to the statistics
+void climateDHTUpdate() {
+  sensors_event_t event;
+  bool read = true;
+
+  climate_dht->humidity().getEvent(&event);
+  if (!isnan(event.relative_humidity))
+    climate_humidity = event.relative_humidity;
+  else
+    read = false;
+
+  climate_dht->temperature().getEvent(&event);
+  if (!isnan(event.temperature))
+    climate_temperature = event.temperature;
+  else
+    read = false;
+
+  if (read) {
+    climate_read = true;
+    int16_t sample[STATS_QUANTITIES];
+    sample[STATS_HUMIDITY] = climate_humidity * 10;
+    sample[STATS_TEMPERATURE] = climate_temperature * 10;
+    statsAdd(sample, millis());
+  }
+}
+
+// Saves the humidity and temperature (in tenths) to the EEPROM log
+void climateLogUpdate() {
+  if (!climate_read)
+    return;
+
+  int16_t values[LOG_CHANNELS] = {(int16_t)(climate_humidity * 10), (int16_t)(climate_temperature * 10)};
+  logAppend(values, millis());
+}
+
+// Schedule the display, contrast, DHT and log jobs with `every`, call from setup()
+void climateSchedule(ClimateEvery every) {
+  sensor_t humidity_sensor;
+  climate_dht->humidity().getSensor(&humidity_sensor);
+
+  Serial.print(F("  " CLIMATE_NAME "Updating LCD every ")); Serial.print(lcd_update_interval); Serial.println(F("ms"));
+  climate_lcd_job = every("lcd", climateLCDUpdate, lcd_update_interval);
+  Serial.print(F("  " CLIMATE_NAME "Updating LCD Contrast every ")); Serial.print(lcd_contrast_update_interval); Serial.println(F("ms"));
+  climate_contrast_job = every("contrast", climateContrastUpdate, lcd_contrast_update_interval);
+  Serial.print(F("  " CLIMATE_NAME "Updating DHT Sensor every ")); Serial.print(humidity_sensor.min_delay / 1000); Serial.println(F("ms"));
+  every("dht", climateDHTUpdate, humidity_sensor.min_delay / 1000);
+  Serial.print(F("  " CLIMATE_NAME "Logging readings every ")); Serial.print(log_interval);
+  Serial.print(F("ms from page ")); Serial.println(log_page);
+  climate_log_job = every("log", climateLogUpdate, log_interval);
+}
+
+// Puts new intervals into effect, each job runs once more at its old one
+void climateIntervalsChanged() {
+  if (climate_lcd_job != WHEEL_NONE)
+    wheel_jobs[climate_lcd_job].period = lcd_update_interval;
+  if (climate_contrast_job != WHEEL_NONE)
+    wheel_jobs[climate_contrast_job].period = lcd_contrast_update_interval;
+  if (climate_log_job != WHEEL_NONE)
+    wheel_jobs[climate_log_job].period = log_interval;
+}
+
+
+// What to do for each button on the remote
+struct ClimateIRCommand {
+  uint16_t command;
+  bool repeats;      // whether holding the button down keeps acting on it
+  void (*handler)();
+};
+const ClimateIRCommand CLIMATE_IR_COMMANDS[] = {
+  {0x45, false, climateToggleLCD},    // power
+  {0x44, false, climatePrevPage},     // previous
+  {0x43, false, climateNextPage},     // next
+  {0x09, true,  climateContrastUp},   // up
+  {0x07, true,  climateContrastDown}, // down
+};
+const byte CLIMATE_NUM_IR_COMMANDS = sizeof(CLIMATE_IR_COMMANDS) / sizeof(CLIMATE_IR_COMMANDS[0]);
+
+// Runs in the receiver's interrupt once a frame is complete, so keep it short
+void climateIRReceived() {
+  // noise and frames it can't make out are dropped, but the receiver always starts again
+  if (IrReceiver.decode() && IrReceiver.decodedIRData.protocol != UNKNOWN) {
+    uint8_t next = (climate_ir_head + 1) & (CLIMATE_IR_QUEUE - 1);
+    if (next == climate_ir_tail) {
+      climate_ir_dropped++;
+    } else {
+      climate_ir_queue[climate_ir_head].command = IrReceiver.decodedIRData.command;
+      climate_ir_queue[climate_ir_head].flags = IrReceiver.decodedIRData.flags;
+      climate_ir_queue[climate_ir_head].time = micros();
+      climate_ir_head = next;
+    }
+  }
+
+  IrReceiver.resume();
+}
+
+// Start the IR receiver on `pin` and have it queue every press it decodes, call from setup()
+void climateIRBegin(uint8_t pin) {
+  IrReceiver.begin(pin);
+  IrReceiver.registerReceiveCompleteCallback(climateIRReceived);
+
+  Serial.print(F("  " CLIMATE_NAME "Queueing up to ")); Serial.print(CLIMATE_IR_QUEUE); Serial.println(F(" IR presses"));
+}
+
+// Whether there are presses waiting for climateIRDispatch()
+bool climateIRPending() {
+  return climate_ir_tail != climate_ir_head;
+}
+
+// Find and run the handler for a command
+void climateIRHandle(uint16_t command, bool repeat, unsigned long pressed) {
+  for (byte c = 0; c < CLIMATE_NUM_IR_COMMANDS; c++) {
+    if (CLIMATE_IR_COMMANDS[c].command != command)
+      continue;
+    if (repeat && !CLIMATE_IR_COMMANDS[c].repeats)
+      return;
+
+    CLIMATE_IR_COMMANDS[c].handler();
+    Serial.print(F(CLIMATE_NAME "IR 0x")); Serial.print(command, HEX);
+    Serial.print(repeat ? F(" repeat") : F(" press"));
+    Serial.print(F(" handled after ")); Serial.print(micros() - pressed); Serial.println(F("us"));
+    return;
+  }
+
+  if (!repeat) {
+    Serial.print(F(CLIMATE_NAME "Pressed unused button ")); Serial.println(command);
+  }
+}
+
+// Act on every queued IR press
+void climateIRDispatch() {
+  while (climateIRPending()) {
+    ClimatePress press;
+    noInterrupts();
+    press.command = climate_ir_queue[climate_ir_tail].command;
+    press.flags = climate_ir_queue[climate_ir_tail].flags;
+    press.time = climate_ir_queue[climate_ir_tail].time;
+    climate_ir_tail = (climate_ir_tail + 1) & (CLIMATE_IR_QUEUE - 1);
+    interrupts();
+
+    // a repeat code means the last button is still held down
+    bool repeat = press.flags & IRDATA_FLAGS_IS_REPEAT;
+    if (!repeat)
+      climate_last_command = press.command;
+    climateIRHandle(climate_last_command, repeat, press.time);
+  }
+}
+
+#endif // CLIMATEDISPLAY_H
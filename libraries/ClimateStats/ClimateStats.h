@@ -0,0 +1,214 @@
+/* Rolling statistics of the DHT readings over a few windows (1 minute, 1 hour, 1 day).
+ * Each window is split into STATS_BUCKETS buckets. A sample only touches the bucket that is
+ * filling, and when a bucket fills it is pushed onto monotonic queues that keep the window's
+ * minimum and maximum at their front, so every update is O(1) and nothing is ever recomputed
+ * over the history. Readings are kept in tenths of a unit to stay in integer math.
+ */
+#ifndef CLIMATESTATS_H
+#define CLIMATESTATS_H
+
+#include <Arduino.h>
+
+#define STATS_BUCKETS 6    // buckets per window
+#define STATS_WINDOWS 3
+#define STATS_QUANTITIES 2 // humidity, temperature
+#define STATS_HUMIDITY 0
+#define STATS_TEMPERATURE 1
+#define STATS_BUDGET 512   // bytes of RAM the windows may use
+
+// One slice of a window
+struct StatsBucket {
+  int32_t sum[STATS_QUANTITIES];
+  int16_t low[STATS_QUANTITIES];
+  int16_t high[STATS_QUANTITIES];
+  uint16_t count;
+};
+
+// Buckets whose values only get worse from front to back, oldest at the front
+struct StatsQueue {
+  uint8_t bucket[STATS_BUCKETS];
+  uint8_t front, len;
+};
+
+struct StatsWindow {
+  const char* name;
+  unsigned long bucket_ms;   // how long each bucket collects for
+  unsigned long bucket_start;
+  uint8_t head;              // bucket that is filling
+  uint8_t complete;          // finished buckets before it that are still in the window
+  StatsBucket buckets[STATS_BUCKETS];
+  int32_t sum[STATS_QUANTITIES]; // over every bucket in the window
+  uint32_t count;
+  StatsQueue lows[STATS_QUANTITIES], highs[STATS_QUANTITIES];
+};
+
+StatsWindow stats_windows[STATS_WINDOWS] = {
+  {"1m", 60000UL / STATS_BUCKETS},
+  {"1h", 3600000UL / STATS_BUCKETS},
+  {"1d", 86400000UL / STATS_BUCKETS},
+};
+static_assert(sizeof(stats_windows) <= STATS_BUDGET, "climate statistics are over their RAM budget");
+
+
+// Start a bucket with nothing in it
+void statsClearBucket(StatsBucket& b) {
+  for (byte q = 0; q < STATS_QUANTITIES; q++) {
+    b.sum[q] = 0;
+    b.low[q] = INT16_MAX;
+    b.high[q] = INT16_MIN;
+  }
+  b.count = 0;
+}
+
+// Add a finished bucket to the back of a queue, dropping everything it beats
+void statsQueuePush(StatsWindow& w, StatsQueue& queue, byte q, bool highs, uint8_t bucket) {
+  int16_t value = highs ? w.buckets[bucket].high[q] : w.buckets[bucket].low[q];
+
+  while (queue.len > 0) {
+    StatsBucket& last = w.buckets[queue.bucket[(queue.front + queue.len - 1) % STATS_BUCKETS]];
+    if (highs ? last.high[q] > value : last.low[q] < value)
+      break;
+    queue.len--;
+  }
+
+  queue.bucket[(queue.front + queue.len) % STATS_BUCKETS] = bucket;
+  queue.len++;
+}
+
+// Drop a bucket that is leaving the window from the front of a queue.
+// Everything in a queue is still in the window so the index can't be ambiguous.
+void statsQueueExpire(StatsQueue& queue, uint8_t bucket) {
+  if (queue.len > 0 && queue.bucket[queue.front] == bucket) {
+    queue.front = (queue.front + 1) % STATS_BUCKETS;
+    queue.len--;
+  }
+}
+
+// Finish the filling bucket and start the next one, reusing the oldest
+void statsRoll(StatsWindow& w) {
+  if (w.buckets[w.head].count > 0) {
+    for (byte q = 0; q < STATS_QUANTITIES; q++) {
+      statsQueuePush(w, w.lows[q], q, false, w.head);
+      statsQueuePush(w, w.highs[q], q, true, w.head);
+    }
+  }
+
+  w.head = (w.head + 1) % STATS_BUCKETS;
+  if (w.complete < STATS_BUCKETS - 1) {
+    w.complete++;
+  } else {
+    // the bucket we are about to reuse falls out of the window
+    StatsBucket& old = w.buckets[w.head];
+    for (byte q = 0; q < STATS_QUANTITIES; q++) {
+      w.sum[q] -= old.sum[q];
+      statsQueueExpire(w.lows[q], w.head);
+      statsQueueExpire(w.highs[q], w.head);
+    }
+    w.count -= old.count;
+  }
+
+  statsClearBucket(w.buckets[w.head]);
+  w.bucket_start += w.bucket_ms;
+}
+
+// Start every window empty from `now`
+void statsBegin(unsigned long now) {
+  for (byte i = 0; i < STATS_WINDOWS; i++) {
+    StatsWindow& w = stats_windows[i];
+    w.bucket_start = now;
+    w.head = 0;
+    w.complete = 0;
+    w.count = 0;
+    for (byte q = 0; q < STATS_QUANTITIES; q++) {
+      w.sum[q] = 0;
+      w.lows[q].len = w.highs[q].len = 0;
+      w.lows[q].front = w.highs[q].front = 0;
+    }
+    statsClearBucket(w.buckets[0]);
+  }
+}
+
+// Add a sample of every quantity (in tenths) taken at `now` to every window
+void statsAdd(const int16_t values[STATS_QUANTITIES], unsigned long now) {
+  for (byte i = 0; i < STATS_WINDOWS; i++) {
+    StatsWindow& w = stats_windows[i];
+
+    // a long gap between samples only has to empty the window once
+    for (byte r = 0; r < STATS_BUCKETS && now - w.bucket_start >= w.bucket_ms; r++)
+      statsRoll(w);
+    if (now - w.bucket_start >= w.bucket_ms)
+      w.bucket_start = now;
+
+    StatsBucket& b = w.buckets[w.head];
+    for (byte q = 0; q < STATS_QUANTITIES; q++) {
+      b.sum[q] += values[q];
+      b.low[q] = min(b.low[q], values[q]);
+      b.high[q] = max(b.high[q], values[q]);
+      w.sum[q] += values[q];
+    }
+    b.count++;
+    w.count++;
+  }
+}
+
+// Window statistics for one quantity, all in tenths
+int16_t statsLow(StatsWindow& w, byte q) {
+  int16_t low = w.buckets[w.head].low[q];
+  if (w.lows[q].len > 0)
+    low = min(low, w.buckets[w.lows[q].bucket[w.lows[q].front]].low[q]);
+  return low;
+}
+
+int16_t statsHigh(StatsWindow& w, byte q) {
+  int16_t high = w.buckets[w.head].high[q];
+  if (w.highs[q].len > 0)
+    high = max(high, w.buckets[w.highs[q].bucket[w.highs[q].front]].high[q]);
+  return high;
+}
+
+int16_t statsMean(StatsWindow& w, byte q) {
+  return w.count ? w.sum[q] / (int32_t)w.count : 0;
+}
+
+// Change per hour between the oldest and newest buckets in the window
+int16_t statsRate(StatsWindow& w, byte q) {
+  StatsBucket& newest = w.buckets[w.head];
+  StatsBucket& oldest = w.buckets[(w.head + STATS_BUCKETS - w.complete) % STATS_BUCKETS];
+  if (w.complete == 0 || newest.count == 0 || oldest.count == 0)
+    return 0;
+
+  int32_t change = newest.sum[q] / (int32_t)newest.count - oldest.sum[q] / (int32_t)oldest.count;
+  // over the span in seconds, the change is between two int16_t so times 3600 fits
+  int32_t span = w.bucket_ms / 1000 * w.complete;
+  int32_t rate = change * 3600 / (span ? span : 1);
+  return rate > INT16_MAX ? INT16_MAX : rate < INT16_MIN ? INT16_MIN : rate;
+}
+
+// Print a value in tenths as a decimal
+void printTenths(Print& out, int16_t tenths) {
+  if (tenths < 0) {
+    out.print('-');
+    tenths = -tenths;
+  }
+  out.print(tenths / 10);
+  out.print('.');
+  out.print(tenths % 10);
+}
+
+// Passes on the first `width` characters printed to it and drops the rest, so a value can't run
+// into whatever is next to it on the display
+struct ClippedPrint : public Print {
+  Print& out;
+  uint8_t left;
+
+  ClippedPrint(Print& out, uint8_t width) : out(out), left(width) {}
+
+  size_t write(uint8_t c) {
+    if (left == 0)
+      return 0;
+    left--;
+    return out.write(c);
+  }
+};
+
+#endif // CLIMATESTATS_H
@@ -0,0 +1,334 @@
+/* Settings that can be looked at and changed over serial while the sketch runs, and kept in the
+ * EEPROM so they survive a reset.
+ *
+ * A setting is an ordinary global with its default as its initial value, so the sketch reads it
+ * exactly as it would a constant. A table in flash gives each one a name, a type and the values
+ * it can be set to:
+ *
+ *   unsigned int blink_time = 1000;
+ *   char code[5] = "1324";
+ *   constexpr ConfigParam CONFIG[] PROGMEM = {
+ *     {"blink_time", CONFIG_U16, &blink_time, 50, 10000},
+ *     {"code", CONFIG_TEXT, code, 4, 4},  // a char array of high + 1
+ *   };
+ *   CONFIG_CHECK(CONFIG);                 // they fit in CONFIG_SIZE bytes of EEPROM
+ *
+ *   configBegin(CONFIG, 2);               // in setup(), loads the saved values if there are any
+ *   char command = configPoll(Serial);    // in loop()
+ *
+ * configPoll() reads what's come in over serial without a String. A line starting with a capital
+ * letter is one of the sketch's own one letter commands and is handed back at once, same as a
+ * Serial.read() of it. Any other line is for the console:
+ *   list                  every setting, its value and range
+ *   get <name>
+ *   set <name> <value>    changes the value in RAM straight away
+ *   commit                saves every value to the EEPROM
+ *   revert                puts back the saved values
+ *   erase                 forgets the saved values, the defaults come back at the next reset
+ *
+ * The saved values are a 3 byte header (layout, length, CRC-8) and then every setting's bytes in
+ * table order, written before the header the same as a SensorLog page. The layout is a CRC of
+ * the table's names, types and ranges, so values saved by a sketch with a different table are
+ * ignored rather than read into the wrong settings.
+ *
+ * A setting with a `changed` function has it called after it's set or loaded, to work out
+ * anything that depends on it once instead of every time it's used.
+ */
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#ifndef CONFIG_SIZE
+#define CONFIG_SIZE 64                         // EEPROM bytes kept for the settings
+#endif
+#ifndef CONFIG_START
+#define CONFIG_START (E2END + 1 - CONFIG_SIZE) // the end of the EEPROM, out of the way of a log at 0
+#endif
+#define CONFIG_HEADER 3 // layout, length and CRC-8
+#define CONFIG_NAME 16  // longest name + 1
+#define CONFIG_LINE 40  // longest console line + 1
+#define CONFIG_WORDS 3  // most words in a console line
+
+static_assert(CONFIG_START + CONFIG_SIZE <= E2END + 1, "the settings go past the end of the EEPROM");
+
+// Setting types
+#define CONFIG_U8 0
+#define CONFIG_U16 1
+#define CONFIG_I16 2
+#define CONFIG_U32 3
+#define CONFIG_TEXT 4 // a char array of high + 1, holding from low to high characters
+
+struct ConfigParam {
+  char name[CONFIG_NAME];
+  uint8_t type;
+  void* value;       // the global the sketch reads
+  long low, high;    // the values it can be set to, or the shortest and longest text
+  void (*changed)(); // called after the value is set or loaded, can be NULL
+};
+
+const ConfigParam* config_table; // in flash
+uint8_t config_count = 0;
+uint8_t config_layout = 0;       // CRC-8 of the table, saved with the values
+uint8_t config_body = 0;         // bytes the values take
+char config_line[CONFIG_LINE];   // console line being typed
+uint8_t config_len = 0;          // chars in it, CONFIG_LINE once it's too long
+
+
+// Bytes a setting takes
+constexpr uint8_t configBytes(uint8_t type, long high) {
+  return type == CONFIG_TEXT ? high + 1 : type == CONFIG_U8 ? 1 : type == CONFIG_U32 ? 4 : 2;
+}
+
+constexpr unsigned configBodySize(const ConfigParam* table, uint8_t n) {
+  return n == 0 ? 0 : configBytes(table[0].type, table[0].high) + configBodySize(table + 1, n - 1);
+}
+
+// Check a constexpr table of settings at compile time
+#define CONFIG_CHECK(table) \
+  static_assert(configBodySize(table, sizeof(table) / sizeof(table[0])) <= CONFIG_SIZE - CONFIG_HEADER, \
+                "the settings don't fit in CONFIG_SIZE bytes of EEPROM")
+
+// CRC-8 (polynomial 0x07) continuing from `crc`
+uint8_t configCrc(uint8_t crc, const void* data, uint8_t len) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  while (len--) {
+    crc ^= *bytes++;
+    for (byte b = 0; b < 8; b++)
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+// Copy a setting's entry out of flash
+ConfigParam configParam(uint8_t i) {
+  ConfigParam param;
+  memcpy_P(&param, &config_table[i], sizeof(param));
+  return param;
+}
+
+// Index of the setting called `name`, -1 if there isn't one
+int8_t configFind(const char* name) {
+  for (uint8_t i = 0; i < config_count; i++)
+    if (strcmp_P(name, config_table[i].name) == 0)
+      return i;
+  return -1;
+}
+
+// A number setting's value
+long configValue(const ConfigParam& param) {
+  switch (param.type) {
+  case CONFIG_U8:
+    return *(uint8_t*)param.value;
+  case CONFIG_U16:
+    return *(uint16_t*)param.value;
+  case CONFIG_I16:
+    return *(int16_t*)param.value;
+  default:
+    return *(uint32_t*)param.value;
+  }
+}
+
+// Set a setting from what was typed for it, returns false and leaves it as it was if that isn't
+// a value it can take
+bool configSet(const ConfigParam& param, const char* text) {
+  if (param.type == CONFIG_TEXT) {
+    size_t len = strlen(text);
+    if (len < (size_t)param.low || len > (size_t)param.high)
+      return false;
+    strcpy((char*)param.value, text);
+  } else {
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end || value < param.low || value > param.high)
+      return false;
+
+    switch (param.type) {
+    case CONFIG_U8:
+      *(uint8_t*)param.value = value;
+      break;
+    case CONFIG_U16:
+      *(uint16_t*)param.value = value;
+      break;
+    case CONFIG_I16:
+      *(int16_t*)param.value = value;
+      break;
+    default:
+      *(uint32_t*)param.value = value;
+    }
+  }
+
+  if (param.changed)
+    param.changed();
+  return true;
+}
+
+// Read the saved values into the settings, returns false and leaves them as they are if there
+// aren't any saved for this table
+bool configLoad() {
+  uint8_t header[CONFIG_HEADER];
+  for (byte i = 0; i < CONFIG_HEADER; i++)
+    header[i] = EEPROM.read(CONFIG_START + i);
+  if (header[0] != config_layout || header[1] != config_body)
+    return false;
+
+  uint8_t crc = configCrc(0, header, 2);
+  for (byte i = 0; i < header[1]; i++) {
+    uint8_t b = EEPROM.read(CONFIG_START + CONFIG_HEADER + i);
+    crc = configCrc(crc, &b, 1);
+  }
+  if (crc != header[2])
+    return false;
+
+  int address = CONFIG_START + CONFIG_HEADER;
+  for (uint8_t i = 0; i < config_count; i++) {
+    ConfigParam param = configParam(i);
+    uint8_t bytes = configBytes(param.type, param.high);
+    for (byte b = 0; b < bytes; b++)
+      ((uint8_t*)param.value)[b] = EEPROM.read(address++);
+    if (param.type == CONFIG_TEXT)
+      ((char*)param.value)[param.high] = '\0';
+    if (param.changed)
+      param.changed();
+  }
+  return true;
+}
+
+// Save every setting, the header that makes them valid last
+void configCommit() {
+  uint8_t header[CONFIG_HEADER] = {config_layout, config_body, 0};
+  uint8_t crc = configCrc(0, header, 2);
+
+  int address = CONFIG_START + CONFIG_HEADER;
+  for (uint8_t i = 0; i < config_count; i++) {
+    ConfigParam param = configParam(i);
+    uint8_t bytes = configBytes(param.type, param.high);
+    crc = configCrc(crc, param.value, bytes);
+    for (byte b = 0; b < bytes; b++)
+      EEPROM.update(address++, ((uint8_t*)param.value)[b]);
+  }
+
+  header[2] = crc;
+  for (byte i = 0; i < CONFIG_HEADER; i++)
+    EEPROM.update(CONFIG_START + i, header[i]);
+}
+
+// Make the saved values invalid
+void configErase() {
+  EEPROM.update(CONFIG_START + 1, 0xff);
+}
+
+// Take the table of `count` settings and load any saved values, call from setup()
+bool configBegin(const ConfigParam* table, uint8_t count) {
+  config_table = table;
+  config_count = count;
+
+  config_layout = 0;
+  config_body = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    ConfigParam param = configParam(i);
+    config_body += configBytes(param.type, param.high);
+    config_layout = configCrc(config_layout, param.name, strlen(param.name));
+    config_layout = configCrc(config_layout, &param.type, sizeof(param.type));
+    config_layout = configCrc(config_layout, &param.low, sizeof(param.low));
+    config_layout = configCrc(config_layout, &param.high, sizeof(param.high));
+  }
+  return configLoad();
+}
+
+// Print "<name> <value>", and the values it can take if `range`
+void configPrint(Print& out, const ConfigParam& param, bool range) {
+  out.print(param.name);
+  out.print(' ');
+  if (param.type == CONFIG_TEXT)
+    out.print((const char*)param.value);
+  else
+    out.print(configValue(param));
+
+  if (range) {
+    out.print(F("  ("));
+    out.print(param.low);
+    out.print(F(" to "));
+    out.print(param.high);
+    out.print(param.type == CONFIG_TEXT ? F(" chars)") : F(")"));
+  }
+  out.println();
+}
+
+// Split a line into words in place, returns how many, CONFIG_WORDS + 1 if there are too many
+uint8_t configWords(char* line, char** words) {
+  uint8_t n = 0;
+  for (char* c = line; *c; c++) {
+    if (*c == ' ' || *c == '\t') {
+      *c = '\0';
+    } else if (c == line || c[-1] == '\0') {
+      if (n == CONFIG_WORDS)
+        return n + 1;
+      words[n++] = c;
+    }
+  }
+  return n;
+}
+
+// Run a console line
+void configRun(Print& out, char* line) {
+  char* words[CONFIG_WORDS];
+  uint8_t n = configWords(line, words);
+  if (n == 0)
+    return;
+
+  int8_t i = n > 1 ? configFind(words[1]) : -1;
+  if (n > 1 && i < 0 && n <= CONFIG_WORDS) {
+    out.print(F("? no setting ")); out.println(words[1]);
+  } else if (n == 1 && !strcmp_P(words[0], PSTR("list"))) {
+    for (i = 0; i < (int8_t)config_count; i++)
+      configPrint(out, configParam(i), true);
+  } else if (n == 2 && !strcmp_P(words[0], PSTR("get"))) {
+    configPrint(out, configParam(i), false);
+  } else if (n == 3 && !strcmp_P(words[0], PSTR("set"))) {
+    ConfigParam param = configParam(i);
+    if (configSet(param, words[2]))
+      configPrint(out, param, false);
+    else {
+      out.print(F("? out of range, "));
+      configPrint(out, param, true);
+    }
+  } else if (n == 1 && !strcmp_P(words[0], PSTR("commit"))) {
+    configCommit();
+    out.println(F("saved"));
+  } else if (n == 1 && !strcmp_P(words[0], PSTR("revert"))) {
+    out.println(configLoad() ? F("loaded the saved values") : F("? nothing saved"));
+  } else if (n == 1 && !strcmp_P(words[0], PSTR("erase"))) {
+    configErase();
+    out.println(F("erased, the defaults are back after a reset"));
+  } else {
+    out.println(F("? list, get <name>, set <name> <value>, commit, revert or erase"));
+  }
+}
+
+// Read whatever has come in. Returns a one letter command for the sketch, or 0 if there isn't
+// one; console lines are run here when their newline comes in.
+char configPoll(Stream& io) {
+  while (io.available()) {
+    char c = io.read();
+    if (c == '\r' || c == '\n') {
+      if (config_len == CONFIG_LINE) {
+        io.println(F("? line too long"));
+      } else if (config_len) {
+        config_line[config_len] = '\0';
+        configRun(io, config_line);
+      }
+      config_len = 0;
+    } else if (config_len == 0 && c >= 'A' && c <= 'Z') {
+      return c;
+    } else if (config_len < CONFIG_LINE - 1) {
+      config_line[config_len++] = c;
+    } else {
+      config_len = CONFIG_LINE;
+    }
+  }
+  return 0;
+}
+
+#endif // CONFIGSTORE_H
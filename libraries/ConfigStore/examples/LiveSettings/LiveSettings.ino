@@ -0,0 +1,49 @@
+/* Blinks the LED on pin 13 at a rate that can be changed over serial, and greets with a word
+ * that can be too. Try "list", "set blink_ms 100" and "commit", then reset the board.
+ */
+#include <ConfigStore.h>
+
+const int LED_PIN = 13;
+
+unsigned int blink_ms = 500;  // one blink, on and then off, takes this long
+char greeting[9] = "hello";
+unsigned long blink_count = 0;
+
+// every LED change is checked against this instead of dividing the period each time
+unsigned int half_ms = 250;
+
+void blinkChanged() {
+  half_ms = blink_ms / 2;
+}
+
+constexpr ConfigParam CONFIG[] PROGMEM = {
+  {"blink_ms", CONFIG_U16, &blink_ms, 20, 10000, blinkChanged},
+  {"greeting", CONFIG_TEXT, greeting, 1, 8},
+};
+CONFIG_CHECK(CONFIG);
+
+unsigned long last_change = 0;
+
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(LED_PIN, OUTPUT);
+
+  bool saved = configBegin(CONFIG, sizeof(CONFIG) / sizeof(CONFIG[0]));
+  Serial.print(greeting);
+  Serial.println(saved ? F(", using the saved settings") : F(", using the defaults"));
+}
+
+void loop() {
+  // 'C' is this sketch's own command, the console has everything else
+  if (configPoll(Serial) == 'C') {
+    Serial.print(F("blinked "));
+    Serial.println(blink_count);
+  }
+
+  if (millis() - last_change >= half_ms) {
+    last_change = millis();
+    digitalWrite(LED_PIN, !digitalRead(LED_PIN));
+    blink_count++;
+  }
+}
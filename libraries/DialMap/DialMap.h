@@ -0,0 +1,129 @@
+/* Turning a pot reading into a setting without any division at run time.
+ *
+ * map() divides a long every time it's called, which takes the better part of 1000 cycles on an
+ * AVR. Here the curve from a reading (0 to 1023) to a setting is worked out by the compiler
+ * instead, and reading it back is a shift and one multiply:
+ *
+ *   DIAL_LINEAR(lo, hi, reading)  a straight line, with its slope worked out at compile time
+ *   DIAL_TABLE(name, curve, ...)  any other curve, as a table in flash read with dialRead()
+ *
+ * A table holds the curve at DIAL_SEGMENTS + 1 points, every 1 << DIAL_SHIFT counts of the dial
+ * (the last one just past its end), and dialRead() goes in a straight line between them. The
+ * curves are constexpr functions of the point's index i that go at the end of their arguments:
+ *
+ *   dialLinear(lo, hi, i)         evenly from lo to hi
+ *   dialLog(lo, hi, i)            each count multiplies the setting by the same amount, so the
+ *                                 small settings get as much of the dial as the big ones
+ *   dialPoints(points, n, i)      straight between n DialPoints {reading, setting}, two points
+ *                                 with the same setting make a detent the dial sits in
+ *
+ *   const DialPoint COOK_FEEL[] = {{0, 500}, {200, 500}, {400, 1000}, {600, 1000}, {1023, 5000}};
+ *   DIAL_TABLE(cook_dial, dialPoints, COOK_FEEL, 5);
+ *   long cook_time = dialRead(cook_dial, analogRead(A5));
+ *
+ * Settings are 0 to 65535. Detents and corners land on the nearest point of the table, so
+ * 32 counts either way of where they were asked for.
+ */
+#ifndef DIALMAP_H
+#define DIALMAP_H
+
+#include <Arduino.h>
+
+#define DIAL_SHIFT 5                        // counts of the dial between points of a table
+#define DIAL_SEGMENTS (1024 >> DIAL_SHIFT)  // DIAL_TABLE lists this many + 1 points by hand
+
+struct DialPoint {
+  int reading;
+  long setting;
+};
+
+// The reading at point i of a table
+constexpr long dialX(int i) {
+  return (long)i << DIAL_SHIFT;
+}
+
+constexpr uint16_t dialRound(double value) {
+  return value <= 0 ? 0 : value >= 65535 ? 65535 : (uint16_t)(value + 0.5);
+}
+
+// Slope of a straight line from lo at 0 to hi at 1023, in 1/65536ths per count. hi - lo has to
+// be under 32768 for a reading times this to fit in a long.
+constexpr long dialSlope(long lo, long hi) {
+  return ((hi - lo) * 65536L + (hi >= lo ? 511 : -511)) / 1023;
+}
+
+#define DIAL_LINEAR(lo, hi, reading) \
+  ((lo) + (long)(((long)(reading) * dialSlope(lo, hi) + 0x8000L) >> 16))
+
+// exp() and log() by their series, since the ones in math.h can't run at compile time
+constexpr double dialExpSeries(double x, int n, double term, double sum) {
+  return n > 40 ? sum : dialExpSeries(x, n + 1, term * x / n, sum + term * x / n);
+}
+
+constexpr double dialExp(double x) {
+  return x < 0 ? 1 / dialExpSeries(-x, 1, 1, 1) : dialExpSeries(x, 1, 1, 1);
+}
+
+// log(y) = 2 atanh((y - 1) / (y + 1)), which converges quickly for y from 1 to 2
+constexpr double dialLnSeries(double z, double z2, int n, double sum) {
+  return n > 41 ? sum : dialLnSeries(z * z2, z2, n + 2, sum + z / n);
+}
+
+constexpr double dialLn(double y) {
+  return y > 2 ? dialLn(y / 2) + 0.69314718 :
+         y < 1 ? -dialLn(1 / y) :
+         2 * dialLnSeries((y - 1) / (y + 1), ((y - 1) / (y + 1)) * ((y - 1) / (y + 1)), 1, 0);
+}
+
+// The curves, each gives the setting at point i of a table
+constexpr uint16_t dialLinear(long lo, long hi, int i) {
+  return dialRound(lo + (double)(hi - lo) * dialX(i) / 1023);
+}
+
+// lo has to be more than 0
+constexpr uint16_t dialLog(long lo, long hi, int i) {
+  return dialRound(lo * dialExp(dialLn((double)hi / lo) * dialX(i) / 1023));
+}
+
+constexpr uint16_t dialBetween(const DialPoint& a, const DialPoint& b, long x) {
+  return dialRound(a.setting + (double)(b.setting - a.setting) * (x - a.reading) / (b.reading - a.reading));
+}
+
+// Past the last point the line through the last two carries on
+constexpr uint16_t dialPointsFrom(const DialPoint* points, int n, long x, int at) {
+  return at + 2 >= n || x < points[at + 1].reading ?
+    dialBetween(points[at], points[at + 1], x) :
+    dialPointsFrom(points, n, x, at + 1);
+}
+
+constexpr uint16_t dialPoints(const DialPoint* points, int n, int i) {
+  return n < 2 ? (n ? dialRound(points[0].setting) : 0) : dialPointsFrom(points, n, dialX(i), 0);
+}
+
+// Spelled out point by point since C++11 has no other way to fill a PROGMEM array at compile time
+#define DIAL_TABLE(name, curve, ...) \
+  constexpr uint16_t name[DIAL_SEGMENTS + 1] PROGMEM = { \
+    curve(__VA_ARGS__, 0),  curve(__VA_ARGS__, 1),  curve(__VA_ARGS__, 2),  curve(__VA_ARGS__, 3),  \
+    curve(__VA_ARGS__, 4),  curve(__VA_ARGS__, 5),  curve(__VA_ARGS__, 6),  curve(__VA_ARGS__, 7),  \
+    curve(__VA_ARGS__, 8),  curve(__VA_ARGS__, 9),  curve(__VA_ARGS__, 10), curve(__VA_ARGS__, 11), \
+    curve(__VA_ARGS__, 12), curve(__VA_ARGS__, 13), curve(__VA_ARGS__, 14), curve(__VA_ARGS__, 15), \
+    curve(__VA_ARGS__, 16), curve(__VA_ARGS__, 17), curve(__VA_ARGS__, 18), curve(__VA_ARGS__, 19), \
+    curve(__VA_ARGS__, 20), curve(__VA_ARGS__, 21), curve(__VA_ARGS__, 22), curve(__VA_ARGS__, 23), \
+    curve(__VA_ARGS__, 24), curve(__VA_ARGS__, 25), curve(__VA_ARGS__, 26), curve(__VA_ARGS__, 27), \
+    curve(__VA_ARGS__, 28), curve(__VA_ARGS__, 29), curve(__VA_ARGS__, 30), curve(__VA_ARGS__, 31), \
+    curve(__VA_ARGS__, 32) \
+  }; \
+  static_assert(DIAL_SEGMENTS == 32, "DIAL_TABLE lists 33 points")
+
+// The setting for a reading from a DIAL_TABLE
+inline uint16_t dialRead(const uint16_t* table, uint16_t reading) {
+  if (reading > 1023)
+    reading = 1023;
+  uint8_t segment = reading >> DIAL_SHIFT;
+  uint8_t part = reading & ((1 << DIAL_SHIFT) - 1);
+  long from = pgm_read_word(&table[segment]);
+  long to = pgm_read_word(&table[segment + 1]);
+  return from + (((to - from) * part + (1 << (DIAL_SHIFT - 1))) >> DIAL_SHIFT);
+}
+
+#endif // DIALMAP_H
@@ -0,0 +1,49 @@
+/* Prints what a pot on A0 would set through a straight line, a log curve and a curve with
+ * detents, next to map() and how long each took, whenever the pot moves.
+ */
+#include <DialMap.h>
+
+const int POT_PIN = A0;
+
+// 20 Hz to 20 kHz, like a tone knob
+DIAL_TABLE(tone_dial, dialLog, 20, 20000);
+
+// seconds, sitting on 30, 60 and 120
+const DialPoint TIMER_FEEL[] = {
+  {0, 0}, {250, 30}, {350, 30}, {500, 60}, {600, 60}, {800, 120}, {900, 120}, {1023, 300}
+};
+DIAL_TABLE(timer_dial, dialPoints, TIMER_FEEL, sizeof(TIMER_FEEL) / sizeof(TIMER_FEEL[0]));
+
+int last_reading = -1;
+
+
+void setup() {
+  Serial.begin(115200);
+}
+
+void loop() {
+  int reading = analogRead(POT_PIN);
+  if (abs(reading - last_reading) < 4)
+    return;
+  last_reading = reading;
+
+  unsigned long start = micros();
+  long mapped = map(reading, 0, 1023, 0, 255);
+  unsigned long map_time = micros() - start;
+
+  start = micros();
+  long linear = DIAL_LINEAR(0, 255, reading);
+  unsigned long linear_time = micros() - start;
+
+  start = micros();
+  uint16_t tone = dialRead(tone_dial, reading);
+  uint16_t timer = dialRead(timer_dial, reading);
+  unsigned long table_time = (micros() - start) / 2;
+
+  Serial.print(reading);
+  Serial.print(F(": map ")); Serial.print(mapped); Serial.print(F(" in ")); Serial.print(map_time);
+  Serial.print(F("us, linear ")); Serial.print(linear); Serial.print(F(" in ")); Serial.print(linear_time);
+  Serial.print(F("us, tone ")); Serial.print(tone);
+  Serial.print(F(" Hz, timer ")); Serial.print(timer);
+  Serial.print(F(" s, ")); Serial.print(table_time); Serial.println(F("us a table"));
+}
@@ -0,0 +1,272 @@
+/* Pins worked out at compile time, for an Uno (ATmega328P).
+ *
+ * digitalWrite() and digitalRead() look the pin's port, bit and timer up in tables in flash and
+ * turn off any PWM on it every call, about 50 cycles each. Pin<N> knows all of that at compile
+ * time, so Pin<13>::high() is a single SBI and Pin<2>::read() a single SBIC/IN:
+ *
+ *   typedef Pin<13> Led;
+ *   Led::output();
+ *   Led::high();
+ *
+ * high(), low() and write() don't stop PWM on the pin like digitalWrite() does. On a pin that's
+ * been given a duty with pwmWrite() or analogWrite() use pwmWrite(0) or pwmWrite(255), or call
+ * pwmOff() first.
+ *
+ * A PinGroup is a set of pins that can be set up in one go, one write per port. PinLayout joins
+ * pins and groups together so a sketch can check how it uses them at compile time, for example
+ *
+ *   typedef PinGroup<12, 11, 10, 9> Rows;
+ *   static_assert(PinLayout<Rows, Pin<13>, Pin<2> >::distinct, "two things are on one pin");
+ *   static_assert(!Rows::has(13), "the keypad can't use pin 13, its LED pulls the line down");
+ *
+ * Anywhere other than an AVR the calls fall back to digitalWrite() and friends, so the same
+ * sketch still builds for the host simulator.
+ */
+#ifndef FASTPIN_H
+#define FASTPIN_H
+
+#include <Arduino.h>
+
+#define PIN_PORT_B 0
+#define PIN_PORT_C 1
+#define PIN_PORT_D 2
+
+#define PIN_NO_PWM 0
+#define PIN_OC0A 1 // timer 0, which millis() also uses
+#define PIN_OC0B 2
+#define PIN_OC1A 3 // timer 1, which the Servo library takes over
+#define PIN_OC1B 4
+#define PIN_OC2A 5 // timer 2, which tone() takes over
+#define PIN_OC2B 6
+
+// Compile time sums over lists of pin numbers
+struct PinList {
+  static constexpr uint8_t port(uint8_t pin) {
+    return pin < 8 ? PIN_PORT_D : pin < 14 ? PIN_PORT_B : PIN_PORT_C;
+  }
+
+  static constexpr uint8_t mask(uint8_t pin) {
+    return 1 << (pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14);
+  }
+
+  static constexpr uint8_t timer(uint8_t pin) {
+    return pin == 6 ? PIN_OC0A : pin == 5 ? PIN_OC0B : pin == 9 ? PIN_OC1A :
+           pin == 10 ? PIN_OC1B : pin == 11 ? PIN_OC2A : pin == 3 ? PIN_OC2B : PIN_NO_PWM;
+  }
+
+  static constexpr bool has(uint8_t) {
+    return false;
+  }
+
+  template <typename... Pins>
+  static constexpr bool has(uint8_t pin, uint8_t first, Pins... rest) {
+    return pin == first || has(pin, rest...);
+  }
+
+  static constexpr bool distinct() {
+    return true;
+  }
+
+  template <typename... Pins>
+  static constexpr bool distinct(uint8_t first, Pins... rest) {
+    return !has(first, rest...) && distinct(rest...);
+  }
+
+  static constexpr bool valid() {
+    return true;
+  }
+
+  template <typename... Pins>
+  static constexpr bool valid(uint8_t first, Pins... rest) {
+    return first < 20 && valid(rest...);
+  }
+
+  // The bits of a port the pins are on
+  static constexpr uint8_t portMask(uint8_t) {
+    return 0;
+  }
+
+  template <typename... Pins>
+  static constexpr uint8_t portMask(uint8_t port, uint8_t first, Pins... rest) {
+    return (PinList::port(first) == port ? mask(first) : 0) | portMask(port, rest...);
+  }
+};
+
+
+template <uint8_t... Ns>
+struct PinGroup {
+  static_assert(PinList::valid(Ns...), "an Uno only has pins 0 to 19");
+  static constexpr bool distinct = PinList::distinct(Ns...);
+  static_assert(distinct, "a pin is in the group twice");
+
+  typedef PinGroup Group;
+  static constexpr uint8_t size = sizeof...(Ns);
+  static constexpr uint8_t mask_b = PinList::portMask(PIN_PORT_B, Ns...);
+  static constexpr uint8_t mask_c = PinList::portMask(PIN_PORT_C, Ns...);
+  static constexpr uint8_t mask_d = PinList::portMask(PIN_PORT_D, Ns...);
+
+  static constexpr bool has(uint8_t pin) {
+    return PinList::has(pin, Ns...);
+  }
+
+  static constexpr bool onPort(uint8_t port) {
+    return PinList::portMask(port, Ns...) != 0;
+  }
+
+#ifdef __AVR__
+  static void output() {
+    DDRB |= mask_b;
+    DDRC |= mask_c;
+    DDRD |= mask_d;
+  }
+
+  static void input() {
+    DDRB &= ~mask_b;
+    DDRC &= ~mask_c;
+    DDRD &= ~mask_d;
+  }
+
+  // Every pin HIGH or LOW, one write to each port
+  static void write(bool level) {
+    uint8_t sreg = SREG;
+    cli(); // an interrupt could be writing another pin on the same port
+    if (level) {
+      PORTB |= mask_b;
+      PORTC |= mask_c;
+      PORTD |= mask_d;
+    } else {
+      PORTB &= ~mask_b;
+      PORTC &= ~mask_c;
+      PORTD &= ~mask_d;
+    }
+    SREG = sreg;
+  }
+#else
+  static void output() {
+    uint8_t pins[] = {Ns...};
+    for (uint8_t i = 0; i < size; i++)
+      pinMode(pins[i], OUTPUT);
+  }
+
+  static void input() {
+    uint8_t pins[] = {Ns...};
+    for (uint8_t i = 0; i < size; i++)
+      pinMode(pins[i], INPUT);
+  }
+
+  static void write(bool level) {
+    uint8_t pins[] = {Ns...};
+    for (uint8_t i = 0; i < size; i++)
+      digitalWrite(pins[i], level);
+  }
+#endif
+};
+
+
+// Joins pins and groups into one group, which checks they don't share a pin
+template <typename... Parts>
+struct PinJoin;
+
+template <>
+struct PinJoin<> {
+  typedef PinGroup<> Group;
+};
+
+template <uint8_t... Ns>
+struct PinJoin<PinGroup<Ns...> > {
+  typedef PinGroup<Ns...> Group;
+};
+
+template <uint8_t... As, uint8_t... Bs, typename... Rest>
+struct PinJoin<PinGroup<As...>, PinGroup<Bs...>, Rest...> : PinJoin<PinGroup<As..., Bs...>, Rest...> {};
+
+template <typename... Parts>
+using PinLayout = typename PinJoin<typename Parts::Group...>::Group;
+
+
+template <uint8_t N>
+struct Pin {
+  static_assert(N < 20, "an Uno only has pins 0 to 19");
+
+  typedef PinGroup<N> Group;
+  static constexpr uint8_t number = N;
+  static constexpr uint8_t port = PinList::port(N);
+  static constexpr uint8_t mask = PinList::mask(N);
+  static constexpr uint8_t timer = PinList::timer(N);
+  static constexpr bool pwm = timer != PIN_NO_PWM;
+
+#ifdef __AVR__
+  static volatile uint8_t& portReg() {
+    return port == PIN_PORT_B ? PORTB : port == PIN_PORT_C ? PORTC : PORTD;
+  }
+
+  static volatile uint8_t& ddrReg() {
+    return port == PIN_PORT_B ? DDRB : port == PIN_PORT_C ? DDRC : DDRD;
+  }
+
+  static volatile uint8_t& pinReg() {
+    return port == PIN_PORT_B ? PINB : port == PIN_PORT_C ? PINC : PIND;
+  }
+
+  static void output() { ddrReg() |= mask; }
+  static void input() { ddrReg() &= ~mask; portReg() &= ~mask; }
+  static void inputPullup() { ddrReg() &= ~mask; portReg() |= mask; }
+  static void high() { portReg() |= mask; }
+  static void low() { portReg() &= ~mask; }
+  static void toggle() { pinReg() = mask; } // writing a 1 to PINx flips the pin
+  static bool read() { return pinReg() & mask; }
+
+  // Disconnect the pin from its timer, so it goes back to what high() and low() set
+  static void pwmOff() {
+    switch (timer) {
+    case PIN_OC0A: TCCR0A &= ~_BV(COM0A1); break;
+    case PIN_OC0B: TCCR0A &= ~_BV(COM0B1); break;
+    case PIN_OC1A: TCCR1A &= ~_BV(COM1A1); break;
+    case PIN_OC1B: TCCR1A &= ~_BV(COM1B1); break;
+    case PIN_OC2A: TCCR2A &= ~_BV(COM2A1); break;
+    case PIN_OC2B: TCCR2A &= ~_BV(COM2B1); break;
+    }
+  }
+
+  // analogWrite() without the lookups, the timers are left as the Arduino core set them up
+  static void pwmWrite(uint8_t duty) {
+    static_assert(pwm, "only pins 3, 5, 6, 9, 10 and 11 have PWM");
+    if (duty == 0 || duty == 255) {
+      pwmOff();
+      write(duty);
+      return;
+    }
+    switch (timer) {
+    case PIN_OC0A: OCR0A = duty; TCCR0A |= _BV(COM0A1); break;
+    case PIN_OC0B: OCR0B = duty; TCCR0A |= _BV(COM0B1); break;
+    case PIN_OC1A: OCR1A = duty; TCCR1A |= _BV(COM1A1); break;
+    case PIN_OC1B: OCR1B = duty; TCCR1A |= _BV(COM1B1); break;
+    case PIN_OC2A: OCR2A = duty; TCCR2A |= _BV(COM2A1); break;
+    case PIN_OC2B: OCR2B = duty; TCCR2A |= _BV(COM2B1); break;
+    }
+  }
+#else
+  static void output() { pinMode(N, OUTPUT); }
+  static void input() { pinMode(N, INPUT); }
+  static void inputPullup() { pinMode(N, INPUT_PULLUP); }
+  static void high() { digitalWrite(N, HIGH); }
+  static void low() { digitalWrite(N, LOW); }
+  static void toggle() { digitalWrite(N, !digitalRead(N)); }
+  static bool read() { return digitalRead(N); }
+  static void pwmOff() {}
+
+  static void pwmWrite(uint8_t duty) {
+    static_assert(pwm, "only pins 3, 5, 6, 9, 10 and 11 have PWM");
+    analogWrite(N, duty);
+  }
+#endif
+
+  static void write(bool level) {
+    if (level)
+      high();
+    else
+      low();
+  }
+};
+
+#endif // FASTPIN_H
@@ -0,0 +1,93 @@
+/* Times digitalWrite(), digitalRead() and analogWrite() against the same calls through Pin<N>,
+ * in CPU cycles counted by Timer1, and prints them once a second. Nothing needs wiring up, pin
+ * 13 is the LED, pin 2 is read and pin 6 gets PWM.
+ */
+#include <FastPin.h>
+
+const int RUNS = 100;
+
+typedef Pin<13> Led;
+typedef Pin<2> Input;
+typedef Pin<6> Dimmed;
+
+volatile bool sink; // so the reads aren't optimized away
+
+
+// Timer1 counting every cycle, RUNS calls are well under its 65536
+void startCounting() {
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TCNT1 = 0;
+}
+
+// Cycles per call, less what an empty loop takes
+float cyclesPerCall(unsigned int counted, unsigned int empty) {
+  return (float)(counted - empty) / RUNS;
+}
+
+void report(const __FlashStringHelper* name, float arduino, float fast) {
+  Serial.print(name);
+  Serial.print(F(": "));
+  Serial.print(arduino, 1);
+  Serial.print(F(" cycles, Pin<N> "));
+  Serial.print(fast, 1);
+  Serial.print(F(", "));
+  Serial.print(arduino - fast, 1);
+  Serial.println(F(" saved a call"));
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  Led::output();
+  Input::input();
+  Dimmed::output();
+}
+
+void loop() {
+  unsigned int empty, slow, fast;
+  uint8_t sreg = SREG;
+  cli(); // the millis() interrupt would land in some runs and not others
+
+  startCounting();
+  for (int i = 0; i < RUNS; i++)
+    asm volatile("");
+  empty = TCNT1;
+
+  startCounting();
+  for (int i = 0; i < RUNS; i++)
+    digitalWrite(13, i & 1);
+  slow = TCNT1;
+  startCounting();
+  for (int i = 0; i < RUNS; i++)
+    Led::write(i & 1);
+  fast = TCNT1;
+  float write_slow = cyclesPerCall(slow, empty), write_fast = cyclesPerCall(fast, empty);
+
+  startCounting();
+  for (int i = 0; i < RUNS; i++)
+    sink = digitalRead(2);
+  slow = TCNT1;
+  startCounting();
+  for (int i = 0; i < RUNS; i++)
+    sink = Input::read();
+  fast = TCNT1;
+  float read_slow = cyclesPerCall(slow, empty), read_fast = cyclesPerCall(fast, empty);
+
+  startCounting();
+  for (int i = 0; i < RUNS; i++)
+    analogWrite(6, i | 1);
+  slow = TCNT1;
+  startCounting();
+  for (int i = 0; i < RUNS; i++)
+    Dimmed::pwmWrite(i | 1);
+  fast = TCNT1;
+  float pwm_slow = cyclesPerCall(slow, empty), pwm_fast = cyclesPerCall(fast, empty);
+
+  SREG = sreg;
+  report(F("digitalWrite"), write_slow, write_fast);
+  report(F("digitalRead"), read_slow, read_fast);
+  report(F("analogWrite"), pwm_slow, pwm_fast);
+  Serial.println();
+  delay(1000);
+}
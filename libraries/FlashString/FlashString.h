@@ -0,0 +1,21 @@
+/* Tables of names kept in flash.
+ *
+ * F("...") keeps a message in flash instead of the 2 KB of RAM, but a table of names needs the
+ * table itself in flash as well: an array of pointers in flash to strings in flash. Read an
+ * entry back with flashString() and print it like an F() string.
+ *
+ *   const char red_name[] PROGMEM = "Red";
+ *   const char green_name[] PROGMEM = "Green";
+ *   const char* const colour_names[] PROGMEM = {red_name, green_name};
+ *   Serial.println(flashString(colour_names, 1));
+ */
+#ifndef FLASHSTRING_H
+#define FLASHSTRING_H
+
+#include <Arduino.h>
+
+const __FlashStringHelper* flashString(const char* const* table, int i) {
+  return (const __FlashStringHelper*)pgm_read_ptr(&table[i]);
+}
+
+#endif // FLASHSTRING_H
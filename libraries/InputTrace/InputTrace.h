@@ -0,0 +1,126 @@
+/* A record of every input a sketch reads, so host/replay can run a serial capture back through
+ * the same code.
+ *
+ * Define TRACE before including this and the sketch prints what it read as "#T <hex>" lines,
+ * one line per loop. Without TRACE the wrappers only read the pin.
+ *
+ *   traceLoop();                              // first thing in loop()
+ *   int pot = traceAnalog(A0);                // in place of analogRead(A0)
+ *   int door = traceDigital(4);               // in place of digitalRead(4)
+ *   unsigned long us = tracePulse(7, HIGH, 30000);
+ *   char key = traceKey(keypad.getKey());
+ *
+ * Each record is a tag byte, the kind in the top 3 bits and the pin in the bottom 5, then a
+ * varint value for the kinds that have one. A pin that reads the same as it did last time is
+ * only a tag byte. The kinds have to match host/sim/trace.h.
+ */
+#ifndef INPUTTRACE_H
+#define INPUTTRACE_H
+
+#include <Arduino.h>
+
+#define TRACE_LOOP 0    // start of a loop, value is ms since the last one
+#define TRACE_KEY 1     // a key press, value is the key
+#define TRACE_NO_KEY 2  // no key pressed, no value
+#define TRACE_ANALOG 3  // analogRead(), value is the reading
+#define TRACE_DIGITAL 4 // digitalRead(), value is the level
+#define TRACE_PULSE 5   // pulseIn(), value is the pulse in us
+#define TRACE_SAME 6    // the pin read the same as it did last time, no value
+#define TRACE_PINS 20
+#define TRACE_BUFFER 32 // bytes, the line is printed early if a loop reads more than fits
+
+#ifdef TRACE
+uint8_t trace_buffer[TRACE_BUFFER];
+uint8_t trace_len = 0;
+unsigned long trace_time = 0;         // millis() at the start of the last loop
+unsigned long trace_last[TRACE_PINS]; // last value read from each pin
+uint32_t trace_seen = 0;              // bit for each pin that has been read
+
+void traceFlush() {
+  if (trace_len == 0)
+    return;
+
+  Serial.print(F("#T "));
+  for (byte i = 0; i < trace_len; i++) {
+    if (trace_buffer[i] < 0x10) Serial.print('0');
+    Serial.print(trace_buffer[i], HEX);
+  }
+  Serial.println();
+  trace_len = 0;
+}
+
+void traceRecord(uint8_t kind, uint8_t pin, bool has_value, unsigned long value) {
+  if (trace_len + 6 > TRACE_BUFFER)
+    traceFlush();
+
+  trace_buffer[trace_len++] = kind << 5 | pin;
+  if (has_value) {
+    while (value >= 0x80) {
+      trace_buffer[trace_len++] = value | 0x80;
+      value >>= 7;
+    }
+    trace_buffer[trace_len++] = value;
+  }
+}
+
+// Record a reading from a pin, as TRACE_SAME if it hasn't changed
+void traceValue(uint8_t kind, uint8_t pin, unsigned long value) {
+  if ((trace_seen & (1UL << pin)) && trace_last[pin] == value) {
+    traceRecord(TRACE_SAME, pin, false, 0);
+  } else {
+    traceRecord(kind, pin, true, value);
+    trace_last[pin] = value;
+    trace_seen |= 1UL << pin;
+  }
+}
+#endif
+
+// Call at the start of every loop
+void traceLoop() {
+#ifdef TRACE
+  traceFlush();
+  unsigned long now = millis();
+  traceRecord(TRACE_LOOP, 0, true, now - trace_time);
+  trace_time = now;
+#endif
+}
+
+// Record which key, if any, was pressed
+char traceKey(char key) {
+#ifdef TRACE
+  if (key)
+    traceRecord(TRACE_KEY, 0, true, (uint8_t)key);
+  else
+    traceRecord(TRACE_NO_KEY, 0, false, 0);
+#endif
+  return key;
+}
+
+// analogRead() that records the reading
+int traceAnalog(uint8_t pin) {
+  int value = analogRead(pin);
+#ifdef TRACE
+  traceValue(TRACE_ANALOG, pin, value);
+#endif
+  return value;
+}
+
+// digitalRead() that records the level
+int traceDigital(uint8_t pin) {
+  int value = digitalRead(pin);
+#ifdef TRACE
+  traceValue(TRACE_DIGITAL, pin, value);
+#endif
+  return value;
+}
+
+// pulseIn() that records the pulse
+unsigned long tracePulse(uint8_t pin, uint8_t level, unsigned long timeout) {
+  unsigned long time = pulseIn(pin, level, timeout);
+#ifdef TRACE
+  traceValue(TRACE_PULSE, pin, time);
+#endif
+  return time;
+}
+
+#endif // INPUTTRACE_H
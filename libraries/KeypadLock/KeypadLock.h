@@ -0,0 +1,282 @@
+/* The keypad lock's state machine, shared by task5/5.2.cpp and multiapp's lock app.
+ *
+ * Four states: locked, unlocked, hypnotic and sweep. A code typed on the keypad moves between
+ * them, with the pot as a second key: unlocking needs it low, locking in a window above that, and
+ * turning it into a window higher still sweeps the lights while locked. The codes and windows are
+ * settings (see ConfigStore.h) and the bolt is a servo moved by ServoMotion.h, so nothing waits.
+ *
+ * The sketch reads the board and lights the lights, the state machine only decides:
+ *
+ *   constexpr ConfigParam CONFIG[] PROGMEM = {LOCK_CONFIG};  // plus any settings of its own
+ *   servoAttach(3, LOCK_LOCKED_ANGLE);                        // in setup()
+ *   if (key) lockKey(key);                                    // every press
+ *   lockStep(analogRead(A5));                                 // every 100 ms or so
+ *
+ *   void lockLight(uint8_t light, bool on) { ... }            // defined by the sketch
+ *
+ * Presses wait in a queue of LOCK_KEY_QUEUE until there are enough for a code, and in the locked
+ * and unlocked states until the bolt has got where it's going. Debug messages are
+ * "<ms>: <LOCK_NAME>(<state>) <message>", off if NO_DEBUG is defined.
+ */
+#ifndef KEYPADLOCK_H
+#define KEYPADLOCK_H
+
+#include <Arduino.h>
+#include <FlashString.h>
+#include <ConfigStore.h>
+#include <ServoMotion.h>
+
+#ifndef LOCK_NAME
+#define LOCK_NAME ""              // in front of the state in debug messages, "lock " say
+#endif
+#ifndef LOCK_KEY_QUEUE
+#define LOCK_KEY_QUEUE 20         // presses that can be waiting
+#endif
+#define LOCK_LOCKED_ANGLE 90
+#define LOCK_UNLOCKED_ANGLE 0
+#define LOCK_SERVO_MOVE_MS 500    // time the bolt takes to move, starting and stopping gently
+#define LOCK_HYPNOTIC_STEP 200    // ms each light is on for in the hypnotic state
+
+// Lights for lockLight()
+#define LOCK_RED 0
+#define LOCK_GREEN 1
+#define LOCK_WHITE 2
+
+// Turn a light on or off, defined by the sketch
+void lockLight(uint8_t light, bool on);
+
+enum LockState {
+  LOCK_LOCKED,
+  LOCK_UNLOCKED,
+  LOCK_HYPNOTIC,
+  LOCK_SWEEP
+};
+// in flash, read one with flashString(lock_state_names, state)
+const char lock_locked_name[] PROGMEM = "Locked";
+const char lock_unlocked_name[] PROGMEM = "Unlocked";
+const char lock_hypnotic_name[] PROGMEM = "Hypnotic";
+const char lock_sweep_name[] PROGMEM = "Sweep";
+const char* const lock_state_names[] PROGMEM = {
+  lock_locked_name,
+  lock_unlocked_name,
+  lock_hypnotic_name,
+  lock_sweep_name
+};
+
+// Settings
+char unlock_code[5] = "1324"; // takes it from locked to unlocked
+char lock_code[5] = "4231";   // takes it from unlocked or sweep to locked
+short unlock_pot_max = 44;    // the pot has to be at most this to unlock
+short lock_pot_min = 45;      // and in this window to lock
+short lock_pot_max = 90;
+short sweep_pot_min = 91;     // the pot in this window sweeps when locked
+short sweep_pot_max = 110;
+#define LOCK_CONFIG \
+  {"unlock_code", CONFIG_TEXT, unlock_code, 4, 4}, \
+  {"lock_code", CONFIG_TEXT, lock_code, 4, 4}, \
+  {"unlock_pot_max", CONFIG_I16, &unlock_pot_max, 0, 1023}, \
+  {"lock_pot_min", CONFIG_I16, &lock_pot_min, 0, 1023}, \
+  {"lock_pot_max", CONFIG_I16, &lock_pot_max, 0, 1023}, \
+  {"sweep_pot_min", CONFIG_I16, &sweep_pot_min, 0, 1023}, \
+  {"sweep_pot_max", CONFIG_I16, &sweep_pot_max, 0, 1023}
+
+#ifdef NO_DEBUG
+bool lock_debug = false;          // the host fuzzer builds with NO_DEBUG
+#else
+bool lock_debug = true;           // set to false to not show debug messages
+#endif
+bool lock_print_queue = true;     // false to not show the queue after every press
+LockState lock_state = LOCK_LOCKED;
+bool lock_entered = false;        // whether the state has done what it does on the way in
+char lock_queue[LOCK_KEY_QUEUE];
+uint8_t lock_queue_front = 0, lock_queue_count = 0;
+uint8_t lock_hypnotic_light = 0;  // light that's on in the hypnotic state
+unsigned long lock_hypnotic_time = 0; // millis() it came on
+bool lock_sweep_on = false;
+
+
+// Print "<ms>: <LOCK_NAME>(<state>) <msg><data>"
+template <typename T>
+void lockDebug(const __FlashStringHelper* msg, T data) {
+  if (!lock_debug)
+    return;
+  Serial.print(millis());
+  Serial.print(F(": " LOCK_NAME "("));
+  Serial.print(flashString(lock_state_names, lock_state));
+  Serial.print(F(") "));
+  Serial.print(msg);
+  Serial.println(data);
+}
+
+void lockDebug(const __FlashStringHelper* msg) {
+  lockDebug(msg, "");
+}
+
+void lockChangeState(LockState next) {
+  lockDebug(F("Changing to "), flashString(lock_state_names, next));
+  lock_state = next;
+  lock_entered = false;
+}
+
+void lockLights(bool red, bool green, bool white) {
+  lockLight(LOCK_RED, red);
+  lockLight(LOCK_GREEN, green);
+  lockLight(LOCK_WHITE, white);
+}
+
+// Queue a key press, call for every press
+void lockKey(char key) {
+  lockDebug(F("Adding key: "), key);
+  if (lock_queue_count == LOCK_KEY_QUEUE) {
+    lockDebug(F("Keypad queue is full"));
+    return;
+  }
+  lock_queue[(lock_queue_front + lock_queue_count++) % LOCK_KEY_QUEUE] = key;
+
+  if (lock_debug && lock_print_queue) {
+    char queue[3 * LOCK_KEY_QUEUE + 1];
+    for (uint8_t i = 0; i < lock_queue_count; i++) {
+      queue[3 * i] = '[';
+      queue[3 * i + 1] = lock_queue[(lock_queue_front + i) % LOCK_KEY_QUEUE];
+      queue[3 * i + 2] = ']';
+    }
+    queue[3 * lock_queue_count] = '\0';
+    lockDebug(F("Key queue "), queue);
+  }
+}
+
+// Take the oldest n presses into sequence (n + 1 chars) if there are that many yet
+bool lockTakeKeys(char* sequence, uint8_t n) {
+  if (lock_queue_count < n)
+    return false;
+  for (uint8_t i = 0; i < n; i++) {
+    sequence[i] = lock_queue[lock_queue_front];
+    lock_queue_front = (lock_queue_front + 1) % LOCK_KEY_QUEUE;
+  }
+  lock_queue_count -= n;
+  sequence[n] = '\0';
+  return true;
+}
+
+// True if the keys pressed match a code kept in flash, F("1234")
+bool lockIsCode(const char* sequence, const __FlashStringHelper* code) {
+  return strcmp_P(sequence, (const char*)code) == 0;
+}
+
+// True if the keys pressed match a code setting, unlock_code
+bool lockIsCode(const char* sequence, const char* code) {
+  return strcmp(sequence, code) == 0;
+}
+
+void lockUnknown(const char* sequence, int pot) {
+  lockDebug(F("Unknown code "), sequence);
+  lockDebug(F("at potentiometer reading "), pot);
+}
+
+
+void lockRunLocked(int pot) {
+  if (!lock_entered) {
+    servoMoveTo(LOCK_LOCKED_ANGLE, LOCK_SERVO_MOVE_MS);
+    lockLights(HIGH, LOW, LOW);
+    lock_entered = true;
+  }
+
+  // keys wait in the queue until the bolt is home
+  if (!servoDone())
+    return;
+
+  char sequence[5];
+  if (lockTakeKeys(sequence, 4)) {
+    if (lockIsCode(sequence, F("1234")))
+      lockChangeState(LOCK_HYPNOTIC);
+    else if (lockIsCode(sequence, unlock_code) && pot <= unlock_pot_max)
+      lockChangeState(LOCK_UNLOCKED);
+    else
+      lockUnknown(sequence, pot);
+  } else if (sweep_pot_min <= pot && pot <= sweep_pot_max) {
+    lockChangeState(LOCK_SWEEP);
+  }
+}
+
+void lockRunUnlocked(int pot) {
+  if (!lock_entered) {
+    servoMoveTo(LOCK_UNLOCKED_ANGLE, LOCK_SERVO_MOVE_MS);
+    lockLights(LOW, HIGH, LOW);
+    lock_entered = true;
+  }
+
+  // keys wait in the queue until the bolt is back
+  if (!servoDone())
+    return;
+
+  char sequence[5];
+  if (lockTakeKeys(sequence, 4)) {
+    if (lockIsCode(sequence, F("1234")))
+      lockChangeState(LOCK_HYPNOTIC);
+    else if (lockIsCode(sequence, lock_code) && lock_pot_min <= pot && pot <= lock_pot_max)
+      lockChangeState(LOCK_LOCKED);
+    else
+      lockUnknown(sequence, pot);
+  }
+}
+
+void lockRunHypnotic() {
+  unsigned long now = millis();
+  if (!lock_entered || now - lock_hypnotic_time >= LOCK_HYPNOTIC_STEP) {
+    lockLights(lock_hypnotic_light == 0, lock_hypnotic_light == 1, lock_hypnotic_light == 2);
+    lock_hypnotic_light = (lock_hypnotic_light + 1) % 3;
+    lock_hypnotic_time = now;
+    lock_entered = true;
+  }
+
+  char sequence[2];
+  if (!lockTakeKeys(sequence, 1))
+    return;
+  if (lockIsCode(sequence, F("2")))
+    lockChangeState(LOCK_LOCKED);
+  else if (lockIsCode(sequence, F("3")))
+    lockChangeState(LOCK_UNLOCKED);
+  else if (lockIsCode(sequence, F("4")))
+    lockChangeState(LOCK_SWEEP);
+  else
+    lockDebug(F("Unknown code "), sequence);
+  if (lock_state != LOCK_HYPNOTIC)
+    lock_hypnotic_light = 0; // start from red next time
+}
+
+// The red and green lights blink on every step, the white one is left as it was
+void lockRunSweep() {
+  lock_sweep_on = !lock_sweep_on;
+  lockLight(LOCK_RED, lock_sweep_on);
+  lockLight(LOCK_GREEN, lock_sweep_on);
+
+  char sequence[5];
+  if (lockTakeKeys(sequence, 4)) {
+    if (lockIsCode(sequence, lock_code))
+      lockChangeState(LOCK_LOCKED);
+    else if (lockIsCode(sequence, F("4321")))
+      lockChangeState(LOCK_HYPNOTIC);
+    else
+      lockDebug(F("Unknown code "), sequence);
+  }
+}
+
+// Run one step of the state machine with the pot at `pot`
+void lockStep(int pot) {
+  switch (lock_state) {
+  case LOCK_LOCKED:
+    lockRunLocked(pot);
+    break;
+  case LOCK_UNLOCKED:
+    lockRunUnlocked(pot);
+    break;
+  case LOCK_HYPNOTIC:
+    lockRunHypnotic();
+    break;
+  case LOCK_SWEEP:
+    lockRunSweep();
+    break;
+  }
+}
+
+#endif // KEYPADLOCK_H
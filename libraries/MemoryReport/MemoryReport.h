@@ -0,0 +1,67 @@
+/* How much of the RAM a sketch really uses, measured while it runs.
+ *
+ * Define MEMORY_REPORT before including this and memoryReport() prints
+ * "#M <static> <heap> <stack> <unused>" every MEMORY_REPORT_MS, in bytes: .data and .bss, the
+ * most the heap and the stack have used, and the RAM neither has ever touched. Without it, or
+ * without an AVR, both functions do nothing.
+ *
+ *   memoryPaint();    // first thing in setup()
+ *   memoryReport();   // in loop()
+ *
+ * memoryPaint() fills the free RAM with MEMORY_PAINT, the heap grows up into it and the stack
+ * down, so the longest run still painted is the gap between their high water marks.
+ * host/memreport.py puts these lines next to the sizes from the build.
+ */
+#ifndef MEMORYREPORT_H
+#define MEMORYREPORT_H
+
+#include <Arduino.h>
+
+#ifndef MEMORY_REPORT_MS
+#define MEMORY_REPORT_MS 5000
+#endif
+#define MEMORY_PAINT 0xc5
+
+#if defined(MEMORY_REPORT) && defined(__AVR__)
+extern char __data_start, __heap_start; // from the linker
+extern char* __brkval;                  // the top of the heap, 0 before anything is allocated
+char* memory_low;                       // the bottom of the painted RAM
+unsigned long memory_time = 0;          // millis() of the last report
+
+void memoryPaint() {
+  memory_low = __brkval ? __brkval : &__heap_start;
+  for (char* p = memory_low; p < (char*)SP; p++)
+    *p = MEMORY_PAINT;
+}
+
+void memoryReport() {
+  if (millis() - memory_time < MEMORY_REPORT_MS)
+    return;
+  memory_time = millis();
+
+  char* gap = memory_low;
+  unsigned int gap_len = 0, run = 0;
+  for (char* p = memory_low; p < (char*)SP; p++) {
+    if (*p != (char)MEMORY_PAINT) {
+      run = 0;
+    } else if (++run > gap_len) {
+      gap_len = run;
+      gap = p + 1 - run;
+    }
+  }
+
+  Serial.print(F("#M "));
+  Serial.print(&__heap_start - &__data_start);
+  Serial.print(' ');
+  Serial.print(gap - &__heap_start);
+  Serial.print(' ');
+  Serial.print((char*)RAMEND + 1 - (gap + gap_len));
+  Serial.print(' ');
+  Serial.println(gap_len);
+}
+#else
+void memoryPaint() {}
+void memoryReport() {}
+#endif
+
+#endif // MEMORYREPORT_H
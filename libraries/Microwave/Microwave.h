@@ -0,0 +1,320 @@
+/* The microwave's state machine, shared by task5/5.4.cpp and multiapp's microwave app.
+ *
+ * Waiting, running, paused and finished, moved between by the start/pause and stop buttons and
+ * the door interlock, with the cook time set on the pot. The shortest and longest times and how
+ * long it stays finished are settings (see ConfigStore.h). It runs off millis(), so a step never
+ * waits.
+ *
+ * The sketch reads the board and drives the relay and the light ring, the state machine only
+ * decides:
+ *
+ *   constexpr ConfigParam CONFIG[] PROGMEM = {MICROWAVE_CONFIG};   // plus any of its own
+ *   microwaveBegin();                                              // in setup()
+ *   microwaveStep(pot, start_pause, stop, interlock);              // every 20 ms or so
+ *
+ *   void microwaveRelay(bool on) { ... }                           // defined by the sketch
+ *   void microwaveRing(uint8_t i, uint32_t colour) { ... }         // one light, 0xRRGGBB
+ *   void microwaveRingShow() { ... }                               // show what was set
+ *
+ * A button that changes holds for MICROWAVE_DEBOUNCE ms, every change in the meantime is
+ * ignored. The door interlock isn't debounced: it's taken on every step, and the step that reads
+ * it open drops the relay. Debug messages are "<MICROWAVE_NAME>(<state>) <message>", compiled out if NO_DEBUG is
+ * defined.
+ */
+#ifndef MICROWAVE_H
+#define MICROWAVE_H
+
+#include <Arduino.h>
+#include <FlashString.h>
+#include <ConfigStore.h>
+#include <DialMap.h>
+
+#ifndef MICROWAVE_NAME
+#define MICROWAVE_NAME ""           // in front of the state in debug messages, "microwave " say
+#endif
+#ifndef MICROWAVE_RING_SIZE
+#define MICROWAVE_RING_SIZE 12      // number of lights on the LED ring
+#endif
+#define MICROWAVE_MAX_DURATION 5000 // in milliseconds, max_duration's default
+#define MICROWAVE_MIN_DURATION 500  // in milliseconds, min_duration's default
+#define MICROWAVE_DEBOUNCE 200      // ms to wait until another button can be pressed
+#define MICROWAVE_FLASH_TIME 500    // time to flash all lights on
+#define MICROWAVE_SPIN_LENGTH 4     // how many LEDs are lit when spinning
+#define MICROWAVE_SPIN_TIME 100     // move the spin around every this many ms
+#define MICROWAVE_FINISH_COLOUR 0x7f7f00UL // flash this color when done
+#define MICROWAVE_SPIN_COLOUR 0x0000ffUL   // the spinning is this color
+#define MICROWAVE_PAUSED_COLOUR 0x00ff00UL // flash this color when paused
+
+// Drive the relay for the motor and magnetron, set one light of the ring and show the ring,
+// defined by the sketch
+void microwaveRelay(bool on);
+void microwaveRing(uint8_t i, uint32_t colour);
+void microwaveRingShow();
+
+enum MicrowaveState {
+  MICROWAVE_WAITING,
+  MICROWAVE_RUNNING,
+  MICROWAVE_PAUSED,
+  MICROWAVE_FINISHED,
+};
+// in flash, read one with flashString(microwave_state_names, state)
+const char microwave_waiting_name[] PROGMEM = "Waiting";
+const char microwave_running_name[] PROGMEM = "Running";
+const char microwave_paused_name[] PROGMEM = "Paused";
+const char microwave_finished_name[] PROGMEM = "Finished";
+const char* const microwave_state_names[] PROGMEM = {
+  microwave_waiting_name,
+  microwave_running_name,
+  microwave_paused_name,
+  microwave_finished_name,
+};
+
+// Settings
+unsigned int min_duration = MICROWAVE_MIN_DURATION; // shortest and longest cook times the dial sets
+unsigned int max_duration = MICROWAVE_MAX_DURATION;
+unsigned int finished_time = 4000;                  // time to stay on finished state after timer runs out
+#define MICROWAVE_CONFIG \
+  {"min_duration", CONFIG_U16, &min_duration, 100, 60000}, \
+  {"max_duration", CONFIG_U16, &max_duration, 100, 60000}, \
+  {"finished_time", CONFIG_U16, &finished_time, 0, 60000}
+
+// How the timer dial feels, {pot reading, cook time}: it sits on each whole second up to 3 s,
+// then goes straight up to the longest time, which it reaches on the table's last point but one
+// so the end of the dial gets all of it. The table holds each time as a Q16 fraction of the way
+// from min_duration to max_duration at their defaults, so other settings stretch it with a
+// multiply and a shift instead of the long division in map().
+#define MICROWAVE_DIAL_AT(ms) \
+  ((((ms) - MICROWAVE_MIN_DURATION) * 65535L + (MICROWAVE_MAX_DURATION - MICROWAVE_MIN_DURATION) / 2) / \
+   (MICROWAVE_MAX_DURATION - MICROWAVE_MIN_DURATION))
+const DialPoint MICROWAVE_COOK_DIAL[] = {
+  {0, MICROWAVE_DIAL_AT(MICROWAVE_MIN_DURATION)}, {100, MICROWAVE_DIAL_AT(MICROWAVE_MIN_DURATION)},
+  {200, MICROWAVE_DIAL_AT(1000)}, {300, MICROWAVE_DIAL_AT(1000)},
+  {450, MICROWAVE_DIAL_AT(2000)}, {550, MICROWAVE_DIAL_AT(2000)},
+  {700, MICROWAVE_DIAL_AT(3000)}, {800, MICROWAVE_DIAL_AT(3000)},
+  {992, MICROWAVE_DIAL_AT(MICROWAVE_MAX_DURATION)}, {1023, MICROWAVE_DIAL_AT(MICROWAVE_MAX_DURATION)},
+};
+DIAL_TABLE(microwave_cook_dial, dialPoints, MICROWAVE_COOK_DIAL,
+           sizeof(MICROWAVE_COOK_DIAL) / sizeof(MICROWAVE_COOK_DIAL[0]));
+
+MicrowaveState microwave_state = MICROWAVE_WAITING; // current state
+MicrowaveState microwave_last_state = MICROWAVE_PAUSED; // the state before the current step
+long microwave_timer = 0;             // time to run for once started
+long microwave_start_time = 0;        // when a state started running
+long microwave_led_time = 0;          // when the lights made their last state change
+long microwave_button_time = 0;       // when a button last changed
+int microwave_pot = 0;                // potentiometer value at the beginning of the step
+int microwave_curr_led = 0;           // progress when spinning the light wheel
+bool microwave_start_pause = false;   // whether the start/pause button is pressed
+bool microwave_stop = false;          // whether the stop button is pressed
+bool microwave_interlock = false;     // whether the interlock switch is pressed, the door is shut
+bool microwave_flashing = false;      // whether the flashing ring is all on or all off
+
+
+#ifdef NO_DEBUG
+#define microwaveDebug(...) // nothing, not even reading what would be printed
+#else
+// Print "<MICROWAVE_NAME>(<state>) <msg><data>"
+template <typename T>
+void microwaveDebug(const __FlashStringHelper* msg, T data) {
+  Serial.print(F(MICROWAVE_NAME "("));
+  Serial.print(flashString(microwave_state_names, microwave_state));
+  Serial.print(F(") "));
+  Serial.print(msg);
+  Serial.println(data);
+}
+
+void microwaveDebug(const __FlashStringHelper* msg) {
+  microwaveDebug(msg, "");
+}
+#endif
+
+void microwaveChangeState(MicrowaveState next) {
+  microwave_state = next;
+  microwaveDebug(F("Changing to state: "), flashString(microwave_state_names, next));
+}
+
+// Start up in the waiting state, call from setup()
+void microwaveBegin() {
+  microwaveDebug(F("Starting up"));
+  microwaveChangeState(MICROWAVE_WAITING);
+}
+
+// The cook time for a pot reading, min_duration up to max_duration with the dial's detents
+// where they'd be for the defaults. A max_duration under min_duration is taken as min_duration.
+long microwaveCookTime(int reading) {
+  uint16_t frac = dialRead(microwave_cook_dial, reading);
+  if (max_duration <= min_duration)
+    return min_duration;
+  return min_duration + (((uint32_t)frac * (max_duration - min_duration) + 0x8000) >> 16);
+}
+
+// Take a button's reading, printing it when it changes
+void microwaveButton(bool& button, bool reading, const __FlashStringHelper* name, long now) {
+  if (reading == button)
+    return;
+  microwaveDebug(name, reading);
+  button = reading;
+  microwave_button_time = now;
+}
+
+// Set the relay for the motor and magnetron
+void microwaveSetRelay(bool on) {
+  microwaveDebug(F("Changing microwave state: "), on);
+  microwaveRelay(on);
+}
+
+// Set all of the lights in the LED ring
+void microwaveAllLights(uint32_t colour) {
+  for (uint8_t i = 0; i < MICROWAVE_RING_SIZE; i++)
+    microwaveRing(i, colour);
+  microwaveRingShow();
+}
+
+// Move the lit part of the LED ring around by one
+void microwaveSpinLights() {
+  for (uint8_t l = 0; l < MICROWAVE_RING_SIZE; l++) {
+    bool lit = (l - microwave_curr_led + MICROWAVE_RING_SIZE) % MICROWAVE_RING_SIZE < MICROWAVE_SPIN_LENGTH;
+    microwaveRing(l, lit ? MICROWAVE_SPIN_COLOUR : 0);
+  }
+  microwaveRingShow();
+
+  microwave_curr_led = (microwave_curr_led + 1) % MICROWAVE_RING_SIZE;
+}
+
+// Flip the ring between all `colour` and all off every MICROWAVE_FLASH_TIME
+void microwaveFlashLights(long curr_time, uint32_t colour) {
+  if (curr_time - microwave_led_time < MICROWAVE_FLASH_TIME)
+    return;
+  microwave_flashing = !microwave_flashing;
+  microwave_led_time = curr_time;
+  microwaveAllLights(microwave_flashing ? colour : 0);
+  microwaveDebug(microwave_flashing ? F("Flashing on") : F("Flashing off"));
+}
+
+
+void microwaveWaiting() {
+  if (microwave_last_state != MICROWAVE_WAITING) {
+    microwaveDebug(F("Waiting..."));
+    microwaveAllLights(0);
+  }
+
+  // don't ever leave this state when door open
+  if (microwave_start_pause && microwave_interlock) {
+    microwave_start_pause = false; // prevent the next state from thinking the button is pressed
+
+    microwave_timer = microwaveCookTime(microwave_pot);
+    microwaveDebug(F("Set timer for "), microwave_timer);
+    microwaveChangeState(MICROWAVE_RUNNING);
+  }
+}
+
+void microwaveRunning() {
+  long curr_time = millis();
+
+  if (microwave_last_state != MICROWAVE_RUNNING) {
+    microwaveDebug(F("Running..."));
+    microwaveDebug(F("Timer T-"), microwave_timer);
+    microwave_start_time = curr_time;
+  } else {
+    microwaveDebug(F("Timer T-"), microwave_timer - (curr_time - microwave_start_time));
+  }
+
+  if (!microwave_interlock) {
+    microwaveSetRelay(false);
+    microwaveChangeState(MICROWAVE_PAUSED);
+  } else if (microwave_timer - (curr_time - microwave_start_time) <= 0) { // timer is finished
+    microwaveSetRelay(false);
+    microwaveChangeState(MICROWAVE_FINISHED);
+  } else if (microwave_start_pause) {
+    microwave_start_pause = false;
+    microwave_timer -= curr_time - microwave_start_time; // set timer to remaining time
+    microwaveSetRelay(false);
+    microwaveChangeState(MICROWAVE_PAUSED);
+  } else if (microwave_stop) {
+    microwave_stop = false;
+    microwaveSetRelay(false);
+    microwaveChangeState(MICROWAVE_WAITING);
+  } else { // microwave is still running
+    microwaveSetRelay(true);
+    if (curr_time - microwave_led_time >= MICROWAVE_SPIN_TIME) {
+      microwaveDebug(F("Spinning lights"));
+      microwaveSpinLights();
+    }
+  }
+}
+
+void microwavePaused() {
+  if (microwave_last_state != MICROWAVE_PAUSED)
+    microwaveDebug(F("Paused..."));
+
+  if (microwave_start_pause) {
+    microwaveDebug(F("Resuming..."));
+    microwave_start_pause = false;
+    microwaveAllLights(0);
+    microwaveChangeState(MICROWAVE_RUNNING);
+  } else if (microwave_stop) {
+    microwave_stop = false;
+    microwaveAllLights(0);
+    microwaveChangeState(MICROWAVE_WAITING);
+  } else {
+    microwaveFlashLights(millis(), MICROWAVE_PAUSED_COLOUR);
+  }
+}
+
+void microwaveFinished() {
+  long curr_time = millis();
+
+  if (microwave_last_state != MICROWAVE_FINISHED) {
+    microwaveDebug(F("Finished..."));
+    microwave_start_time = curr_time;
+    microwave_led_time = curr_time;
+  }
+
+  if (!microwave_interlock) {
+    microwaveChangeState(MICROWAVE_WAITING);
+  } else if (curr_time - microwave_start_time >= finished_time) {
+    microwaveChangeState(MICROWAVE_WAITING);
+    microwaveAllLights(0);
+  } else {
+    microwaveFlashLights(curr_time, MICROWAVE_FINISH_COLOUR);
+  }
+}
+
+// Take the pot and the buttons as read and run one step of the state machine
+void microwaveStep(int pot, bool start_pause, bool stop, bool interlock) {
+  MicrowaveState before_change = microwave_state;
+
+  if (pot != microwave_pot) {
+    microwaveDebug(F("Potentiometer state: "), pot);
+    microwave_pot = pot;
+  }
+  long now = millis();
+  if (now - microwave_button_time >= MICROWAVE_DEBOUNCE) {
+    microwaveButton(microwave_start_pause, start_pause, F("Updated start/pause button to "), now);
+    microwaveButton(microwave_stop, stop, F("Updated stop button to "), now);
+  }
+  // a bounce of the door switch is the door opening, it mustn't wait out a button's debounce
+  if (interlock != microwave_interlock) {
+    microwaveDebug(F("Updated interlock button to "), interlock);
+    microwave_interlock = interlock;
+  }
+
+  switch (microwave_state) {
+  case MICROWAVE_WAITING:
+    microwaveWaiting();
+    break;
+  case MICROWAVE_RUNNING:
+    microwaveRunning();
+    break;
+  case MICROWAVE_PAUSED:
+    microwavePaused();
+    break;
+  case MICROWAVE_FINISHED:
+    microwaveFinished();
+    break;
+  }
+
+  microwave_last_state = before_change;
+}
+
+#endif // MICROWAVE_H
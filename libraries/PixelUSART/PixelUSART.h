@@ -0,0 +1,262 @@
+/* WS2812 (NeoPixel) output from a USART in SPI mode, a pixel at a time from its interrupt.
+ *
+ * Adafruit_NeoPixel::show() times every bit with the CPU, so interrupts are off for the whole
+ * frame, about 30 us per LED. millis() falls behind and button interrupts wait. Here the USART
+ * times the bits instead. In master SPI mode with UBRR at 2 it shifts bytes out of its TX pin at
+ * 16 / 6 = 2.67 MHz, 375 ns a bit, so 3 of its bits make one WS2812 bit of 1.125 us:
+ *
+ *   0  100  375 ns high, 750 ns low     1  110  750 ns high, 375 ns low
+ *
+ * Every high and low is inside what the WS2812B takes, the shortest, a 1's low, is still above
+ * its 300 ns. A colour byte's 8 bits are 24 bits of symbols, 3 bytes, made from two nibbles
+ * looked up in PIXEL_SYMBOLS, and a pixel is 9 bytes, 27 us.
+ *
+ * A byte is 3 us, too little for an interrupt a byte, so the data register empty interrupt sends
+ * a whole pixel, waiting on the data register between bytes, and then returns. It comes as the
+ * last byte of the pixel before it starts shifting out, so the next pixel's first byte is in
+ * before the shift register runs dry and the line never stops mid-frame. Other interrupts get in between
+ * pixels, and interrupts are only ever off for one pixel, about 27 us.
+ *
+ * Another interrupt that holds the CPU for more than a byte at a pixel boundary, 3 us, lets the
+ * shift register run dry, and while it's dry the line is whatever the USART leaves it at. The
+ * interrupt sees that once it has sent its pixel (TX complete is set), drops the transmitter so
+ * the line falls to its PORT level, low, and leaves the frame for pixelDone() to send again once
+ * the LEDs have latched the part they got. The resend goes out with interrupts off for the whole
+ * frame, like show(), so it can't be broken again. Call pixelDone() from loop() for a broken
+ * frame to be put right within a loop. None of this has been run under simavr or checked on a
+ * scope yet.
+ *
+ * That buys latency, not CPU time. The interrupt spins on the data register until the last byte
+ * of a pixel is in, 24 of the pixel's 27 us, and with its own entry and exit loop() is left under
+ * 2 us of every 27 while a frame goes out. A frame takes as long as show() would, the difference
+ * is that no other interrupt waits for more than one pixel.
+ *
+ *   pixelBegin();                        // in setup()
+ *   pixelSet(0, 0x0000ff);               // 0xRRGGBB, the same as Adafruit_NeoPixel::Color()
+ *   pixelShow();                         // returns once the first pixel is out
+ *   if (pixelDone()) ...                 // the frame is all out, and resends a broken one
+ *
+ * Only one frame is kept by default, and pixelSet() waits for a frame going out to finish. Define
+ * PIXEL_DOUBLE before including this to keep two: pixelSet() changes the back one without waiting
+ * and pixelShow() swaps them, waiting only if the last frame isn't out yet.
+ *
+ * The TX pin and XCK, the clock the USART makes, are taken over. The transmitter is only on while
+ * a frame goes out, between frames the TX pin is a plain output held low. On a Mega that's
+ * USART1, TX1 on pin 18, with XCK1 on a pin that isn't broken out, and Serial still works. An
+ * Uno only has USART0, so the LEDs go on pin 1, pin 4 is the clock and Serial can't be used at
+ * all. The clock
+ * is worked out for a 16 MHz board. Without an AVR, like the host simulator, every pixelShow() is
+ * sent through the NeoPixel library straight away instead.
+ */
+#ifndef PIXELUSART_H
+#define PIXELUSART_H
+
+#include <Arduino.h>
+#ifndef __AVR__
+#include <Adafruit_NeoPixel.h>
+#endif
+
+#ifndef PIXEL_COUNT
+#define PIXEL_COUNT 16     // LEDs in the chain
+#endif
+#define PIXEL_LATCH_US 300 // us the line is kept low after a frame, new WS2812Bs need 280
+#ifdef PIXEL_DOUBLE
+#define PIXEL_BUFFERS 2
+#else
+#define PIXEL_BUFFERS 1
+#endif
+
+// The registers and pins of the USART that's used, the bit numbers are the same for every USART
+#if defined(__AVR__) && defined(UDR1)
+#define PIXEL_UDR UDR1
+#define PIXEL_UCSRA UCSR1A
+#define PIXEL_UCSRB UCSR1B
+#define PIXEL_UCSRC UCSR1C
+#define PIXEL_UBRR UBRR1
+#define PIXEL_TX_vect USART1_TX_vect
+#define PIXEL_UDRE_vect USART1_UDRE_vect
+#define PIXEL_TX_BIT 3  // PD3, pin 18
+#define PIXEL_XCK_BIT 5 // PD5
+#define PIXEL_PIN 18
+#else
+#define PIXEL_UDR UDR0
+#define PIXEL_UCSRA UCSR0A
+#define PIXEL_UCSRB UCSR0B
+#define PIXEL_UCSRC UCSR0C
+#define PIXEL_UBRR UBRR0
+#define PIXEL_TX_vect USART_TX_vect
+#define PIXEL_UDRE_vect USART_UDRE_vect
+#define PIXEL_TX_BIT 1  // PD1, pin 1
+#define PIXEL_XCK_BIT 4 // PD4, pin 4
+#define PIXEL_PIN 1
+#endif
+
+#ifdef __AVR__
+static_assert(F_CPU == 16000000UL, "the 375 ns bit of UBRR 2 is worked out for a 16 MHz board");
+#endif
+
+// The 12 bits of symbols for each nibble of a colour, first bit first: 100 for a 0, 110 for a 1
+const uint16_t PIXEL_SYMBOLS[16] PROGMEM = {
+  0x924, 0x926, 0x934, 0x936, 0x9a4, 0x9a6, 0x9b4, 0x9b6,
+  0xd24, 0xd26, 0xd34, 0xd36, 0xda4, 0xda6, 0xdb4, 0xdb6,
+};
+
+uint8_t pixel_buffers[PIXEL_BUFFERS][PIXEL_COUNT * 3]; // green, red and blue of every pixel, the order they're sent
+uint8_t* pixel_back = pixel_buffers[0];                // the frame pixelSet() changes
+const uint8_t* pixel_front = pixel_buffers[0];         // the frame being sent
+const uint8_t* pixel_next;                             // the next pixel to send
+volatile bool pixel_done = true;                       // whether the last frame is all out
+volatile bool pixel_resend = false;                    // whether it ran dry and has to go again
+unsigned long pixel_latch = 0;                         // micros() the line went low at the end of one
+
+#ifndef __AVR__
+Adafruit_NeoPixel pixel_shim(PIXEL_COUNT, PIXEL_PIN, NEO_GRB + NEO_KHZ800);
+#endif
+
+
+#ifdef __AVR__
+// Send a byte as soon as there's room for it in the data register
+inline void pixelPut(uint8_t b) {
+  while (!(PIXEL_UCSRA & _BV(UDRE0))) {}
+  PIXEL_UDR = b;
+}
+
+// Send the next pixel's 9 bytes. Called with interrupts off.
+void pixelSend() {
+  const uint8_t* colour = pixel_next;
+  for (uint8_t c = 0; c < 3; c++) {
+    uint16_t high = pgm_read_word(&PIXEL_SYMBOLS[colour[c] >> 4]);
+    uint16_t low = pgm_read_word(&PIXEL_SYMBOLS[colour[c] & 0x0f]);
+    pixelPut(high >> 4);
+    pixelPut(high << 4 | low >> 8);
+    pixelPut(low);
+  }
+  pixel_next = colour + 3;
+}
+
+// Turn the transmitter on, the bit rate is only set once it is so XCK starts right
+void pixelTransmit() {
+  PIXEL_UBRR = 0;
+  PIXEL_UCSRB |= _BV(TXEN0);
+  PIXEL_UBRR = 2; // F_CPU / (2 * (2 + 1)), 375 ns a bit
+  PIXEL_UCSRA = _BV(TXC0); // clear the flag left from the last frame
+}
+
+// Turn the transmitter off, the TX pin goes back to its PORT level, low, once whatever is
+// waiting in the USART is out
+void pixelRelease() {
+  PIXEL_UCSRB &= ~(_BV(TXEN0) | _BV(UDRIE0) | _BV(TXCIE0));
+  pixel_latch = micros();
+}
+
+// The last byte of a pixel has started shifting out
+ISR(PIXEL_UDRE_vect) {
+  if (pixel_next == pixel_front + PIXEL_COUNT * 3) {
+    PIXEL_UCSRB = (PIXEL_UCSRB & ~_BV(UDRIE0)) | _BV(TXCIE0);
+    return;
+  }
+  pixelSend();
+  // TX complete only gets set if the shift register ran dry, which has to have been before this
+  // pixel went in: another interrupt held this one up. Looked at after sending so even a gap of a
+  // few cycles before the first byte is seen.
+  if (PIXEL_UCSRA & _BV(TXC0)) {
+    pixelRelease();
+    pixel_resend = true;
+  }
+}
+
+// The last pixel has gone out of the shift register
+ISR(PIXEL_TX_vect) {
+  pixelRelease();
+  pixel_done = true;
+}
+
+// Send the whole frame again with interrupts off, once the part that got out has latched
+void pixelResend() {
+  pixel_resend = false;
+  pixel_next = pixel_front;
+  uint8_t sreg = SREG;
+  cli();
+  pixelTransmit();
+  while (pixel_next != pixel_front + PIXEL_COUNT * 3)
+    pixelSend();
+  PIXEL_UCSRB |= _BV(TXCIE0);
+  SREG = sreg;
+}
+#endif
+
+// Take over the USART and turn every LED off, call from setup()
+void pixelBegin() {
+  memset(pixel_buffers, 0, sizeof(pixel_buffers));
+#ifdef __AVR__
+  // master SPI mode, first bit first, with TX low whenever the transmitter is off
+  PORTD &= ~_BV(PIXEL_TX_BIT);
+  DDRD |= _BV(PIXEL_TX_BIT) | _BV(PIXEL_XCK_BIT);
+  PIXEL_UCSRB = 0;
+  PIXEL_UCSRC = _BV(UMSEL01) | _BV(UMSEL00);
+  pixel_resend = false;
+#else
+  pixel_shim.begin();
+#endif
+  pixel_done = true;
+}
+
+// Whether the last frame is all out. A frame that ran dry is sent again from here, once the
+// LEDs have latched what they got of it.
+bool pixelDone() {
+#ifdef __AVR__
+  if (pixel_resend && micros() - pixel_latch >= PIXEL_LATCH_US)
+    pixelResend();
+#endif
+  return pixel_done;
+}
+
+// Wait for the last frame to go out and the LEDs to take it
+void pixelWait() {
+  while (!pixelDone()) {}
+#ifdef __AVR__
+  while (micros() - pixel_latch < PIXEL_LATCH_US) {}
+#endif
+}
+
+// Set pixel `i` to `colour`, 0xRRGGBB, for the next pixelShow()
+void pixelSet(uint8_t i, uint32_t colour) {
+  if (i >= PIXEL_COUNT)
+    return;
+#ifndef PIXEL_DOUBLE
+  while (!pixelDone()) {} // it's the frame going out
+#endif
+  pixel_back[i * 3] = colour >> 8;
+  pixel_back[i * 3 + 1] = colour >> 16;
+  pixel_back[i * 3 + 2] = colour;
+}
+
+// Start sending the frame pixelSet() has been changing, returns once its first pixel is out
+void pixelShow() {
+  pixelWait();
+#ifdef PIXEL_DOUBLE
+  pixel_front = pixel_back;
+  pixel_back = pixel_buffers[pixel_back == pixel_buffers[0]];
+  memcpy(pixel_back, pixel_front, PIXEL_COUNT * 3); // so a pixel that isn't set again stays the same
+#endif
+
+#ifdef __AVR__
+  pixel_done = false;
+  pixel_next = pixel_front;
+
+  uint8_t sreg = SREG;
+  cli();
+  pixelTransmit();
+  pixelSend();
+  PIXEL_UCSRB |= _BV(UDRIE0);
+  SREG = sreg;
+#else
+  for (uint8_t i = 0; i < PIXEL_COUNT; i++) {
+    const uint8_t* colour = pixel_front + i * 3;
+    pixel_shim.setPixelColor(i, Adafruit_NeoPixel::Color(colour[1], colour[0], colour[2]));
+  }
+  pixel_shim.show();
+#endif
+}
+
+#endif // PIXELUSART_H
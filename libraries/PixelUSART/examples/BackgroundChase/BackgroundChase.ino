@@ -0,0 +1,40 @@
+/* Chases a blue light around a 12 LED ring on pin 18 of a Mega, and prints how many passes of
+ * loop() ran while each frame was going out. With Adafruit_NeoPixel it would be none.
+ */
+#define PIXEL_COUNT 12
+#define PIXEL_DOUBLE
+#include <PixelUSART.h>
+
+const unsigned int STEP_MS = 50;
+
+uint8_t lit = 0;
+unsigned long last_step = 0;
+unsigned long passes = 0; // loop() passes since the last frame started
+bool counting = false;
+
+
+void setup() {
+  Serial.begin(115200);
+  pixelBegin();
+}
+
+void loop() {
+  if (counting) {
+    passes++;
+    if (pixelDone()) {
+      Serial.print(passes);
+      Serial.println(F(" passes while the frame went out"));
+      counting = false;
+    }
+  }
+
+  if (millis() - last_step >= STEP_MS) {
+    last_step = millis();
+    pixelSet(lit, 0);
+    lit = (lit + 1) % PIXEL_COUNT;
+    pixelSet(lit, 0x0000ff);
+    pixelShow();
+    passes = 0;
+    counting = true;
+  }
+}
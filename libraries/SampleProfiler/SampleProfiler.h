@@ -0,0 +1,220 @@
+/* A sampling profiler, a Timer2 interrupt that notes where the sketch was every so often.
+ *
+ * A loop timer says how long a loop took but not which part of it, and timing every helper
+ * changes what's being timed. Here an interrupt PROFILER_HZ times a second takes the address it
+ * interrupted off the stack and counts it in a small table in RAM. After a while the counts say
+ * where the time goes, a function that's in 30% of the samples takes about 30% of the CPU.
+ *
+ *   profilerBegin();                                      // in setup()
+ *   if (Serial.available() && Serial.read() == 'P')       // in loop()
+ *     profilerDump(Serial);
+ *
+ * profilerDump() prints the table as "#S" lines and starts a new one. Sampling stops while it
+ * prints, so the dump doesn't show up in the next one. host/profile.py reads the lines back
+ * against the sketch's .elf and says which function and line each address is in.
+ *
+ * The table holds PROFILER_SLOTS addresses, and every count is halved when one gets to 65535.
+ * Samples that find no room are counted as dropped. If a lot are, define PROFILER_SHIFT to count
+ * every 2^PROFILER_SHIFT instructions as one address, which needs fewer slots.
+ *
+ * Reading a profile:
+ * - Nothing is sampled while interrupts are off. That time lands on the instruction after they
+ *   come back on, the end of Adafruit_NeoPixel::show() or of another interrupt.
+ * - millis()'s interrupt and any other are counted against the instruction they interrupted.
+ * - Power down sleep isn't counted at all, Timer2 stops with the clock. Idle sleep is counted
+ *   against the SLEEP instruction.
+ * - The rate is off from 1 kHz so a loop run off millis() isn't caught at the same point every
+ *   time.
+ *
+ * Timer2 is taken over, so analogWrite() on pins 3 and 11, tone() and SoftPWM stop working.
+ *
+ * Define PROFILER_DUMP_MS and call profilerUpdate() from loop() to dump every that many
+ * milliseconds as well, for a simulator like simavr that shows what the sketch prints but has no
+ * way to send it a 'P':
+ *   timeout 60 simavr -m atmega328p -f 16000000 sketch.ino.elf > capture.txt 2>&1
+ * simavr prints the UART on stderr, in colour, and host/profile.py reads it through both. None of
+ * this has been run under simavr yet.
+ */
+#ifndef SAMPLEPROFILER_H
+#define SAMPLEPROFILER_H
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+
+#ifndef PROFILER_HZ
+#define PROFILER_HZ 1009   // samples a second, as near as Timer2 gets
+#endif
+#ifndef PROFILER_SLOTS
+#define PROFILER_SLOTS 64  // a power of 2, 4 bytes of RAM each
+#endif
+#ifndef PROFILER_SHIFT
+#ifdef __AVR_3_BYTE_PC__
+#define PROFILER_SHIFT 1   // a Mega's 128K words of flash have to fit in 16 bits
+#else
+#define PROFILER_SHIFT 0
+#endif
+#endif
+#ifndef PROFILER_DUMP_MS
+#define PROFILER_DUMP_MS 0 // 0 to only dump when asked
+#endif
+#define PROFILER_PROBES 8  // slots tried before a sample is dropped
+
+struct ProfilerSlot {
+  uint16_t address; // word address >> PROFILER_SHIFT, 0 for a free slot since 0 is the reset vector
+  uint16_t count;
+};
+
+ProfilerSlot profiler_slots[PROFILER_SLOTS];
+uint32_t profiler_samples = 0;
+uint16_t profiler_dropped = 0;
+uint8_t profiler_halved = 0; // times every count has been halved
+uint16_t profiler_hz = 0;    // the rate Timer2 really runs at
+unsigned long profiler_time = 0;
+
+// The interrupted word address, low byte first, left here by the interrupt for __vector_profiler_sample()
+extern "C" {
+volatile uint8_t profiler_pc[3];
+}
+
+
+// Start sampling `hz` times a second, from 62 Hz up
+void profilerBegin(uint16_t hz = PROFILER_HZ) {
+  static const uint16_t prescales[] = {1, 8, 32, 64, 128, 256, 1024}; // CS22:0 is the index + 1
+  uint32_t top = F_CPU / hz;
+  uint8_t cs = 0;
+  while (cs < 6 && top / prescales[cs] > 256)
+    cs++;
+  top /= prescales[cs];
+  if (top > 256)
+    top = 256;
+
+  uint8_t sreg = SREG;
+  cli();
+  TCCR2A = _BV(WGM21); // CTC, the compare match resets the count every OCR2A + 1
+  TCCR2B = cs + 1;
+  TCNT2 = 0;
+  OCR2A = top - 1;
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 |= _BV(OCIE2A);
+  profiler_hz = F_CPU / prescales[cs] / top;
+  profiler_time = millis();
+  SREG = sreg;
+}
+
+void profilerClear() {
+  for (uint8_t i = 0; i < PROFILER_SLOTS; i++) {
+    profiler_slots[i].address = 0;
+    profiler_slots[i].count = 0;
+  }
+  profiler_samples = 0;
+  profiler_dropped = 0;
+  profiler_halved = 0;
+}
+
+// Print the table and start a new one:
+//   #S start <hz> <shift> <samples> <dropped> <halved>
+//   #S <byte address in hex> <count>     for every address sampled
+//   #S end
+void profilerDump(Print& out) {
+  TIMSK2 &= ~_BV(OCIE2A);
+
+  out.print(F("#S start "));
+  out.print(profiler_hz);
+  out.print(' ');
+  out.print(PROFILER_SHIFT);
+  out.print(' ');
+  out.print(profiler_samples);
+  out.print(' ');
+  out.print(profiler_dropped);
+  out.print(' ');
+  out.println(profiler_halved);
+  for (uint8_t i = 0; i < PROFILER_SLOTS; i++) {
+    if (!profiler_slots[i].address)
+      continue;
+    out.print(F("#S "));
+    out.print((uint32_t)profiler_slots[i].address << (PROFILER_SHIFT + 1), HEX);
+    out.print(' ');
+    out.println(profiler_slots[i].count);
+  }
+  out.println(F("#S end"));
+
+  profilerClear();
+  TCNT2 = 0;
+  TIFR2 = _BV(OCF2A); // drop the sample that came due while printing
+  TIMSK2 |= _BV(OCIE2A);
+}
+
+// Dump every PROFILER_DUMP_MS, call it from loop()
+void profilerUpdate(Print& out) {
+#if PROFILER_DUMP_MS
+  if (millis() - profiler_time >= PROFILER_DUMP_MS) {
+    profilerDump(out);
+    profiler_time = millis();
+  }
+#else
+  (void)out;
+#endif
+}
+
+
+// Count the address in profiler_pc. Jumped to from the interrupt rather than called, so it's
+// an interrupt handler itself: it saves what it uses and its RETI goes back to the sketch. The
+// name has to start with __vector for avr-gcc to take it as one.
+extern "C" __attribute__((signal, used)) void __vector_profiler_sample() {
+#ifdef __AVR_3_BYTE_PC__
+  uint16_t address = ((uint32_t)profiler_pc[2] << 16 | profiler_pc[1] << 8 | profiler_pc[0]) >> PROFILER_SHIFT;
+#else
+  uint16_t address = (profiler_pc[1] << 8 | profiler_pc[0]) >> PROFILER_SHIFT;
+#endif
+  profiler_samples++;
+
+  uint8_t slot = (address ^ (address >> 6)) & (PROFILER_SLOTS - 1);
+  for (uint8_t probe = 0; probe < PROFILER_PROBES; probe++) {
+    ProfilerSlot& s = profiler_slots[slot];
+    if (s.address == address || !s.address) {
+      s.address = address;
+      if (++s.count == 0xffff) {
+        for (uint8_t i = 0; i < PROFILER_SLOTS; i++)
+          profiler_slots[i].count >>= 1;
+        profiler_halved++;
+      }
+      return;
+    }
+    slot = (slot + 1) & (PROFILER_SLOTS - 1);
+  }
+  if (profiler_dropped != 0xffff)
+    profiler_dropped++;
+}
+
+// The return address is the only way to know where the sketch was, and it's only at a known
+// place on the stack before the compiler has pushed anything. So this copies it out with three
+// registers saved by hand and goes on to __vector_profiler_sample(). The CPU pushed the address
+// high byte last, so it's the lowest in memory, just above what's pushed here.
+ISR(TIMER2_COMPA_vect, ISR_NAKED) {
+  asm volatile(
+    "push r0\n\t"
+    "push r30\n\t"
+    "push r31\n\t"
+    "in r30, __SP_L__\n\t"
+    "in r31, __SP_H__\n\t"
+#ifdef __AVR_3_BYTE_PC__
+    "ldd r0, Z+4\n\t"
+    "sts profiler_pc+2, r0\n\t"
+    "ldd r0, Z+5\n\t"
+    "sts profiler_pc+1, r0\n\t"
+    "ldd r0, Z+6\n\t"
+    "sts profiler_pc, r0\n\t"
+#else
+    "ldd r0, Z+4\n\t"
+    "sts profiler_pc+1, r0\n\t"
+    "ldd r0, Z+5\n\t"
+    "sts profiler_pc, r0\n\t"
+#endif
+    "pop r31\n\t"
+    "pop r30\n\t"
+    "pop r0\n\t"
+    "%~jmp __vector_profiler_sample\n\t"
+    ::);
+}
+
+#endif // SAMPLEPROFILER_H
@@ -0,0 +1,51 @@
+/* Spends its loop in three helpers that take about 1, 2 and 4 parts of the time, and dumps the
+ * profile every 5 seconds or when sent a 'P'. Run it under simavr for a minute with
+ *   timeout 60 simavr -m atmega328p -f 16000000 WhereTheTimeGoes.ino.elf > capture.txt 2>&1
+ * or keep the serial monitor from a board, and read the capture with
+ *   host/profile.py WhereTheTimeGoes.ino.elf capture.txt
+ * and the helpers should come out near 14%, 29% and 57%, less what Serial takes.
+ */
+#define PROFILER_DUMP_MS 5000
+#include <SampleProfiler.h>
+
+volatile float sink; // so the compiler can't drop the sums
+
+void sumFloats(int n) {
+  float total = 0;
+  for (int i = 1; i <= n; i++)
+    total += 1.0 / i;
+  sink = total;
+}
+
+void sumLongs(int n) {
+  long total = 0;
+  for (long i = 1; i <= n; i++)
+    total += 1000000L / i;
+  sink = total;
+}
+
+void waitAround(unsigned int us) {
+  delayMicroseconds(us);
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  profilerBegin();
+}
+
+void loop() {
+  unsigned long start = micros();
+  sumFloats(20);
+  unsigned long part = micros() - start;
+
+  // make the other two take twice and four times as long as the floats did
+  start = micros();
+  while (micros() - start < 2 * part)
+    sumLongs(4);
+  waitAround(4 * part);
+
+  if (Serial.available() && Serial.read() == 'P')
+    profilerDump(Serial);
+  profilerUpdate(Serial);
+}
@@ -0,0 +1,185 @@
+/* A time series log of sensor readings kept in the EEPROM so it survives a reset.
+ *
+ * The log is a ring of LOG_PAGES pages written in turn, so every page wears evenly. A page is a
+ * 4 byte header (sequence number, length, CRC-8) and then records. The first record on a page
+ * is a key frame holding the time (seconds since reset) and every channel as is, the rest only
+ * hold the change from the record before, all zigzag varint encoded. Most records end up as
+ * three bytes.
+ *
+ * Records are written to the page before its header, and the header's CRC covers the records,
+ * so losing power part way through an append leaves either the old page or an invalid page
+ * behind, never a corrupt one.
+ *
+ * Send 'D' over serial to dump every page as hex for host/log_decode to turn into CSV.
+ */
+#ifndef SENSORLOG_H
+#define SENSORLOG_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#define LOG_START 0      // first EEPROM address used by the log
+#ifndef LOG_PAGES
+#define LOG_PAGES 32     // pages in the ring
+#endif
+#define LOG_PAGE_SIZE 32 // bytes per page, including the header
+#define LOG_HEADER 4
+#define LOG_BODY (LOG_PAGE_SIZE - LOG_HEADER)
+#define LOG_CHANNELS 2   // values in every record
+#define LOG_BOOT 0x80    // length flag on the first page written after a reset
+#define LOG_MAX_RECORD (5 + 3 * LOG_CHANNELS)
+
+uint8_t log_body[LOG_BODY];       // copy of the records on the page being appended to
+uint8_t log_len = 0;              // bytes used in log_body
+uint8_t log_page = 0;             // page being appended to
+uint16_t log_seq = 0;             // its sequence number
+bool log_boot = true;             // whether it is the first page since reset
+int16_t log_last[LOG_CHANNELS];   // values in the last record on the page
+unsigned long log_last_time = 0;  // seconds, time of the last record on the page
+
+
+// CRC-8 (polynomial 0x07) continuing from `crc`
+uint8_t logCrc(uint8_t crc, const uint8_t* data, uint8_t len) {
+  while (len--) {
+    crc ^= *data++;
+    for (byte b = 0; b < 8; b++)
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+int logAddress(uint8_t page) {
+  return LOG_START + page * LOG_PAGE_SIZE;
+}
+
+// Read a page's header and records, returns whether it is a valid page
+bool logReadPage(uint8_t page, uint8_t* header, uint8_t* body) {
+  int address = logAddress(page);
+  for (byte i = 0; i < LOG_HEADER; i++)
+    header[i] = EEPROM.read(address + i);
+
+  uint8_t len = header[2] & ~LOG_BOOT;
+  if (len > LOG_BODY)
+    return false;
+  for (byte i = 0; i < len; i++)
+    body[i] = EEPROM.read(address + LOG_HEADER + i);
+
+  return logCrc(logCrc(0, header, 3), body, len) == header[3];
+}
+
+// Write the records added since `from` and then the header that makes them valid
+void logWritePage(uint8_t from) {
+  int address = logAddress(log_page);
+  for (byte i = from; i < log_len; i++)
+    EEPROM.update(address + LOG_HEADER + i, log_body[i]);
+
+  uint8_t header[LOG_HEADER] = {
+    (uint8_t)(log_seq >> 8), (uint8_t)log_seq, (uint8_t)(log_len | (log_boot ? LOG_BOOT : 0)), 0
+  };
+  header[3] = logCrc(logCrc(0, header, 3), log_body, log_len);
+  for (byte i = 0; i < LOG_HEADER; i++)
+    EEPROM.update(address + i, header[i]);
+}
+
+// Find the newest page and start a new one after it
+void logBegin() {
+  uint8_t header[LOG_HEADER];
+  bool found = false;
+  uint16_t newest_seq = 0;
+  uint8_t newest = LOG_PAGES - 1;
+
+  for (byte page = 0; page < LOG_PAGES; page++) {
+    if (!logReadPage(page, header, log_body))
+      continue;
+
+    uint16_t seq = (header[0] << 8) | header[1];
+    if (!found || (int16_t)(seq - newest_seq) > 0) {
+      found = true;
+      newest_seq = seq;
+      newest = page;
+    }
+  }
+
+  log_page = (newest + 1) % LOG_PAGES;
+  log_seq = found ? newest_seq + 1 : 0;
+  log_len = 0;
+  log_boot = true;
+}
+
+// Move on to the oldest page
+void logNextPage() {
+  log_page = (log_page + 1) % LOG_PAGES;
+  log_seq++;
+  log_len = 0;
+  log_boot = false;
+}
+
+uint8_t logVarint(uint8_t* out, uint32_t value) {
+  uint8_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = value | 0x80;
+    value >>= 7;
+  }
+  out[n++] = value;
+  return n;
+}
+
+uint8_t logZigzag(uint8_t* out, int16_t value) {
+  return logVarint(out, (uint16_t)((value << 1) ^ (value >> 15)));
+}
+
+// Encode a record, as a key frame if the page is empty
+uint8_t logEncode(uint8_t* out, const int16_t* values, unsigned long seconds) {
+  bool key = log_len == 0;
+  uint8_t n = logVarint(out, key ? seconds : seconds - log_last_time);
+  for (byte c = 0; c < LOG_CHANNELS; c++)
+    n += logZigzag(out + n, key ? values[c] : values[c] - log_last[c]);
+  return n;
+}
+
+// Append a record of every channel at `now` (ms)
+void logAppend(const int16_t* values, unsigned long now) {
+  uint8_t record[LOG_MAX_RECORD];
+  unsigned long seconds = now / 1000;
+  uint8_t n = logEncode(record, values, seconds);
+
+  if (log_len + n > LOG_BODY) {
+    logNextPage();
+    n = logEncode(record, values, seconds);
+  }
+
+  uint8_t from = log_len;
+  memcpy(log_body + log_len, record, n);
+  log_len += n;
+  logWritePage(from);
+
+  memcpy(log_last, values, sizeof(log_last));
+  log_last_time = seconds;
+}
+
+// Stream every page as hex, oldest first, one page per line
+void logDump(Print& out) {
+  uint8_t header[LOG_HEADER];
+  uint8_t body[LOG_BODY];
+
+  out.print(F("LOG ")); out.print(LOG_PAGE_SIZE); out.print(' '); out.println(LOG_CHANNELS);
+  for (byte i = 1; i <= LOG_PAGES; i++) {
+    uint8_t page = (log_page + i) % LOG_PAGES;
+    if (!logReadPage(page, header, body))
+      continue;
+
+    out.print(F("P "));
+    for (byte b = 0; b < LOG_HEADER; b++) {
+      if (header[b] < 0x10) out.print('0');
+      out.print(header[b], HEX);
+    }
+    for (byte b = 0; b < (header[2] & ~LOG_BOOT); b++) {
+      if (body[b] < 0x10) out.print('0');
+      out.print(body[b], HEX);
+    }
+    out.println();
+  }
+  out.println(F("END"));
+}
+
+#endif // SENSORLOG_H
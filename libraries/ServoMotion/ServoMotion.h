@@ -0,0 +1,203 @@
+/* Smooth servo moves, planned in fixed point and played out from the Timer1 interrupt.
+ *
+ * Servo.write() sends the horn straight to the new angle as fast as the servo can go, drawing as
+ * much current as it likes on the way, and the delay() after it is only a guess at when it got
+ * there. servoMoveTo(angle, ms) plans a move that speeds up and slows down again and returns at
+ * once. The interrupt that makes the pulses works the next pulse width out from the plan every
+ * 20 ms frame, and servoDone() or a callback says when the move is over.
+ *
+ *   servoAttach(9, 90);       // in setup(), pulses holding 90 degrees
+ *   servoMoveTo(0, 500);      // half a second to get to 0
+ *   if (servoDone()) ...      // in loop()
+ *
+ * servo_profile picks the shape of the next move:
+ *   SERVO_TRAPEZOID  even acceleration over the first and last quarter of the time and an even
+ *                    speed in between, 4/3 of the average
+ *   SERVO_SCURVE     3u^2 - 2u^3, the speed builds up and dies away with no jump at either end,
+ *                    peaking at 3/2 of the average
+ *
+ * Both take u, the fraction of the move's time gone, as a Q15 number and give the fraction of
+ * the way there. u goes up by a step worked out once when the move is planned, so a frame is a
+ * few multiplies and shifts and no division.
+ *
+ * One servo, on any pin. Timer1 is taken over the same as the Servo library does, so the two
+ * can't be used together and analogWrite() on pins 9 and 10 stops working. Without an AVR, like
+ * the host simulator, there's no Timer1: the frames that are due are played out through the
+ * Servo library whenever the sketch calls servoDone() or servoAngle().
+ */
+#ifndef SERVOMOTION_H
+#define SERVOMOTION_H
+
+#include <Arduino.h>
+#ifndef __AVR__
+#include <Servo.h>
+#endif
+
+#define SERVO_MIN_PULSE 544  // us at 0 degrees, the same as the Servo library
+#define SERVO_MAX_PULSE 2400 // us at 180 degrees
+#define SERVO_FRAME 20       // ms from one pulse to the next
+#define SERVO_ONE 32768U     // all of a move, in Q15
+
+#define SERVO_TRAPEZOID 0
+#define SERVO_SCURVE 1
+
+uint8_t servo_profile = SERVO_SCURVE;
+void (*servo_callback)() = NULL;     // called when a move is over, from the interrupt on an AVR
+volatile uint16_t servo_pulse = (SERVO_MIN_PULSE + SERVO_MAX_PULSE) / 2; // us, the pulse going out
+volatile bool servo_moving = false;
+uint16_t servo_from, servo_to;       // us, the pulses the move goes between
+uint16_t servo_u = 0;                // Q15, how much of the move's time has gone
+uint16_t servo_du = SERVO_ONE;       // Q15, how much more goes every frame
+
+#ifdef __AVR__
+volatile uint8_t* servo_port;        // the pin's PORT register
+uint8_t servo_mask;
+bool servo_high = false;             // whether the pulse is being sent, else the gap after it
+#else
+Servo servo_shim;
+unsigned long servo_frame_time = 0;  // millis() of the last frame played out
+#endif
+
+
+// The pulse for an angle
+uint16_t servoPulse(int angle) {
+  return SERVO_MIN_PULSE + (long)constrain(angle, 0, 180) * (SERVO_MAX_PULSE - SERVO_MIN_PULSE) / 180;
+}
+
+// Fraction of the way there (Q15) after a fraction u (Q15) of the time, for the first half of a
+// trapezoid: speeding up to 4/3 until u is 1/4, then steady
+uint16_t servoTrapezoid(uint16_t u) {
+  if (u < SERVO_ONE / 4)
+    return (((uint32_t)u * u >> 15) * 43691) >> 14;  // u^2 * 8/3
+  return ((uint32_t)(u - SERVO_ONE / 8) * 21845) >> 14; // (u - 1/8) * 4/3
+}
+
+// Fraction of the way there (Q15) after a fraction u (Q15) of the time
+uint16_t servoShape(uint16_t u) {
+  if (servo_profile == SERVO_SCURVE) {
+    uint32_t u2 = (uint32_t)u * u >> 15;
+    uint32_t u3 = u2 * u >> 15;
+    return 3 * u2 - 2 * u3;
+  }
+  return u <= SERVO_ONE / 2 ? servoTrapezoid(u) : SERVO_ONE - servoTrapezoid(SERVO_ONE - u);
+}
+
+// Move on by one frame, from the interrupt
+void servoFrame() {
+  if (!servo_moving)
+    return;
+
+  uint16_t u = servo_u + servo_du;
+  if (u > SERVO_ONE)
+    u = SERVO_ONE;
+  servo_u = u;
+  servo_pulse = servo_from + ((((int32_t)servo_to - servo_from) * servoShape(u)) >> 15);
+
+  if (u == SERVO_ONE) {
+    servo_moving = false;
+    if (servo_callback)
+      servo_callback();
+  }
+}
+
+#ifdef __AVR__
+// Every compare match ends either the pulse or the gap after it. Timer1 counts at F_CPU / 8 and
+// starts over from 0 on every match, OCR1A is how long until the next one.
+ISR(TIMER1_COMPA_vect) {
+  if (servo_high) {
+    *servo_port &= ~servo_mask;
+    OCR1A = (SERVO_FRAME * 1000U - servo_pulse) * (F_CPU / 8000000) - 1;
+    servo_high = false;
+    servoFrame(); // the next pulse, worked out while the line is low
+  } else {
+    *servo_port |= servo_mask;
+    OCR1A = servo_pulse * (F_CPU / 8000000) - 1;
+    servo_high = true;
+  }
+}
+#else
+// Play out every frame that's due since the last call
+void servoCatchUp() {
+  unsigned long now = millis();
+  if (!servo_moving) {
+    servo_frame_time = now;
+    return;
+  }
+  while (servo_moving && now - servo_frame_time >= SERVO_FRAME) {
+    servo_frame_time += SERVO_FRAME;
+    servoFrame();
+    servo_shim.write(((long)(servo_pulse - SERVO_MIN_PULSE) * 180 + (SERVO_MAX_PULSE - SERVO_MIN_PULSE) / 2) /
+                     (SERVO_MAX_PULSE - SERVO_MIN_PULSE));
+  }
+}
+#endif
+
+// Start sending pulses on `pin` that hold the servo at `angle`, call from setup()
+void servoAttach(uint8_t pin, int angle) {
+  servo_pulse = servoPulse(angle);
+  servo_moving = false;
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+
+#ifdef __AVR__
+  servo_port = portOutputRegister(digitalPinToPort(pin));
+  servo_mask = digitalPinToBitMask(pin);
+
+  uint8_t sreg = SREG;
+  cli();
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11); // CTC up to OCR1A, F_CPU / 8
+  TCNT1 = 0;
+  OCR1A = 100;                     // the first pulse starts straight away
+  servo_high = false;
+  TIFR1 = _BV(OCF1A);
+  TIMSK1 |= _BV(OCIE1A);
+  SREG = sreg;
+#else
+  servo_shim.attach(pin);
+  servo_shim.write(constrain(angle, 0, 180));
+  servo_frame_time = millis();
+#endif
+}
+
+// Start moving to `angle`, getting there in about `ms`, from wherever the servo is now. A move
+// that's already going is dropped for the new one.
+void servoMoveTo(int angle, unsigned int ms) {
+#ifndef __AVR__
+  servoCatchUp();
+#endif
+  unsigned int frames = ms / SERVO_FRAME;
+  uint16_t to = servoPulse(angle);
+
+  uint8_t sreg = SREG;
+  cli();
+  servo_from = servo_pulse;
+  servo_to = to;
+  servo_u = 0;
+  servo_du = frames ? (SERVO_ONE + frames - 1) / frames : SERVO_ONE;
+  servo_moving = servo_from != servo_to;
+  SREG = sreg;
+}
+
+// Whether the last move is over
+bool servoDone() {
+#ifndef __AVR__
+  servoCatchUp();
+#endif
+  return !servo_moving;
+}
+
+// The angle the servo is being sent to now, part way through a move
+int servoAngle() {
+#ifndef __AVR__
+  servoCatchUp();
+#endif
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t pulse = servo_pulse;
+  SREG = sreg;
+  return ((long)(pulse - SERVO_MIN_PULSE) * 180 + (SERVO_MAX_PULSE - SERVO_MIN_PULSE) / 2) /
+         (SERVO_MAX_PULSE - SERVO_MIN_PULSE);
+}
+
+#endif // SERVOMOTION_H
@@ -0,0 +1,50 @@
+/* Swings a servo on pin 9 between 0 and 180 degrees, a trapezoid one way and an S-curve the
+ * other, and prints the angle it's being sent to as it goes. The loop never waits for a move.
+ */
+#include <ServoMotion.h>
+
+const int SERVO_PIN = 9;
+const unsigned int MOVE_MS = 1500;
+const unsigned int PRINT_MS = 100;
+
+volatile bool arrived = false; // set by the callback, from the interrupt
+unsigned long move_start = 0;
+unsigned long last_print = 0;
+bool to_end = true;
+
+void onArrived() {
+  arrived = true;
+}
+
+// Head for the other end of the swing
+void nextMove() {
+  servo_profile = to_end ? SERVO_TRAPEZOID : SERVO_SCURVE;
+  servoMoveTo(to_end ? 180 : 0, MOVE_MS);
+  to_end = !to_end;
+  move_start = millis();
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  servoAttach(SERVO_PIN, 0);
+  servo_callback = onArrived;
+  nextMove();
+}
+
+void loop() {
+  if (millis() - last_print >= PRINT_MS) {
+    last_print = millis();
+    Serial.print(millis() - move_start);
+    Serial.print(F(" ms  "));
+    Serial.println(servoAngle());
+  }
+
+  if (arrived) {
+    arrived = false;
+    Serial.print(F("There after "));
+    Serial.print(millis() - move_start);
+    Serial.println(F(" ms"));
+    nextMove();
+  }
+}
@@ -0,0 +1,197 @@
+/* Software PWM on any digital pin, driven by a Timer2 interrupt.
+ *
+ * Uses binary code modulation rather than one interrupt per edge. A frame is split into 8
+ * planes, plane k lasts 2^k timer counts and shows bit k of every channel's duty, so an LED
+ * at duty d is on for exactly d of the frame's 255 counts. Every plane is precomputed as one
+ * byte per port, so the interrupt is 8 times a frame and only does a read-modify-write of each
+ * port whatever the number of channels. With the timer at clk/256 a frame is 255 * 16us, which
+ * is 245 Hz on a 16 MHz board.
+ *
+ * softPWMWrite() only changes a back copy of the planes. The interrupt copies it in during the
+ * last plane of a frame, so a channel never shows half of its old duty and half of its new one.
+ *
+ * Timer2 is taken over, so analogWrite() on pins 3 and 11 and tone() stop working.
+ *
+ * Define SOFTPWM_PROFILE before including this to time the interrupt with Timer1 (which breaks
+ * analogWrite() on pins 9 and 10 and the Servo library) and read the CPU it takes with
+ * softPWMLoad().
+ */
+#ifndef SOFTPWM_H
+#define SOFTPWM_H
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+
+#define SOFTPWM_MAX_CHANNELS 20 // every pin on an Uno
+#define SOFTPWM_PORTS 3         // B, C, D
+#define SOFTPWM_PLANES 8
+#define SOFTPWM_FRAME 255       // timer counts in a frame
+#define SOFTPWM_PRESCALE 256
+#define SOFTPWM_OVERHEAD 60     // about how many cycles entering and leaving the interrupt takes
+
+struct SoftPWMChannel {
+  uint8_t pin;
+  uint8_t port;    // 0 for B, 1 for C, 2 for D
+  uint8_t mask;    // the pin's bit in its port
+  bool inverted;   // lit when LOW
+  uint8_t duty;
+};
+
+SoftPWMChannel softpwm_channels[SOFTPWM_MAX_CHANNELS];
+uint8_t softpwm_count = 0;
+
+// Bits of each port owned by a channel, and what they are in each plane
+uint8_t softpwm_mask[SOFTPWM_PORTS];
+volatile uint8_t softpwm_planes[SOFTPWM_PLANES][SOFTPWM_PORTS]; // being shown
+uint8_t softpwm_back[SOFTPWM_PLANES][SOFTPWM_PORTS];             // being written
+volatile bool softpwm_changed = false;
+volatile uint8_t softpwm_plane = 0; // plane being shown
+
+#ifdef SOFTPWM_PROFILE
+volatile uint32_t softpwm_busy = 0;   // cycles spent in the interrupt
+volatile uint16_t softpwm_frames = 0; // frames since the last softPWMLoad()
+#endif
+
+
+// Start the interrupt. Channels can be attached before or after.
+void softPWMBegin() {
+  uint8_t sreg = SREG;
+  cli();
+  TCCR2A = _BV(WGM21);             // CTC, OCR2A sets how long each plane lasts
+  TCCR2B = _BV(CS22) | _BV(CS21);  // clk/256
+  TCNT2 = 0;
+  OCR2A = 0;
+  softpwm_plane = 0;
+  TIMSK2 |= _BV(OCIE2A);
+
+#ifdef SOFTPWM_PROFILE
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10); // free running at the CPU clock
+  softpwm_busy = 0;
+  softpwm_frames = 0;
+#endif
+  SREG = sreg;
+}
+
+int8_t softPWMFind(uint8_t pin) {
+  for (uint8_t c = 0; c < softpwm_count; c++)
+    if (softpwm_channels[c].pin == pin)
+      return c;
+  return -1;
+}
+
+// Put a channel's duty into every back plane
+void softPWMPlane(SoftPWMChannel& ch) {
+  uint8_t sreg = SREG;
+  cli(); // so the interrupt can't copy in a half written channel
+  for (uint8_t k = 0; k < SOFTPWM_PLANES; k++) {
+    if (((ch.duty >> k) & 1) != ch.inverted)
+      softpwm_back[k][ch.port] |= ch.mask;
+    else
+      softpwm_back[k][ch.port] &= ~ch.mask;
+  }
+  softpwm_changed = true;
+  SREG = sreg;
+}
+
+// Make `pin` a PWM output starting off. Returns false if there are no channels left or the pin
+// isn't on port B, C or D.
+bool softPWMAttach(uint8_t pin, bool inverted=false) {
+  if (softPWMFind(pin) >= 0)
+    return true;
+  if (softpwm_count == SOFTPWM_MAX_CHANNELS)
+    return false;
+
+  uint8_t port;
+  switch (digitalPinToPort(pin)) {
+  case PB: port = 0; break;
+  case PC: port = 1; break;
+  case PD: port = 2; break;
+  default: return false;
+  }
+
+  SoftPWMChannel& ch = softpwm_channels[softpwm_count++];
+  ch.pin = pin;
+  ch.port = port;
+  ch.mask = digitalPinToBitMask(pin);
+  ch.inverted = inverted;
+  ch.duty = 0;
+  softPWMPlane(ch);
+
+  digitalWrite(pin, inverted ? HIGH : LOW);
+  pinMode(pin, OUTPUT);
+
+  uint8_t sreg = SREG;
+  cli();
+  softpwm_mask[port] |= ch.mask;
+  SREG = sreg;
+  return true;
+}
+
+// Like analogWrite(), shown from the start of the next frame
+void softPWMWrite(uint8_t pin, uint8_t duty) {
+  int8_t c = softPWMFind(pin);
+  if (c < 0 || softpwm_channels[c].duty == duty)
+    return;
+
+  softpwm_channels[c].duty = duty;
+  softPWMPlane(softpwm_channels[c]);
+}
+
+uint8_t softPWMRead(uint8_t pin) {
+  int8_t c = softPWMFind(pin);
+  return c < 0 ? 0 : softpwm_channels[c].duty;
+}
+
+#ifdef SOFTPWM_PROFILE
+// Percent of the CPU the interrupt has taken since the last call
+float softPWMLoad() {
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t busy = softpwm_busy;
+  uint16_t frames = softpwm_frames;
+  softpwm_busy = 0;
+  softpwm_frames = 0;
+  SREG = sreg;
+
+  if (frames == 0)
+    return 0;
+  return busy * 100.0 / ((float)frames * SOFTPWM_FRAME * SOFTPWM_PRESCALE);
+}
+#endif
+
+
+// End of a plane, show the next one
+ISR(TIMER2_COMPA_vect) {
+#ifdef SOFTPWM_PROFILE
+  uint16_t start = TCNT1;
+#endif
+  uint8_t k = softpwm_plane;
+
+  PORTB = (PORTB & ~softpwm_mask[0]) | softpwm_planes[k][0];
+  PORTC = (PORTC & ~softpwm_mask[1]) | softpwm_planes[k][1];
+  PORTD = (PORTD & ~softpwm_mask[2]) | softpwm_planes[k][2];
+
+  // the compare match resets the count, so the plane lasts OCR2A + 1 counts
+  OCR2A = (1 << k) - 1;
+  softpwm_plane = (k + 1) & (SOFTPWM_PLANES - 1);
+
+  // the last plane is long, take any new duties in now so the next frame shows all of them
+  if (k == SOFTPWM_PLANES - 1) {
+    if (softpwm_changed) {
+      for (uint8_t p = 0; p < SOFTPWM_PLANES; p++)
+        for (uint8_t q = 0; q < SOFTPWM_PORTS; q++)
+          softpwm_planes[p][q] = softpwm_back[p][q];
+      softpwm_changed = false;
+    }
+#ifdef SOFTPWM_PROFILE
+    softpwm_frames++;
+#endif
+  }
+
+#ifdef SOFTPWM_PROFILE
+  softpwm_busy += (uint16_t)(TCNT1 - start) + SOFTPWM_OVERHEAD;
+#endif
+}
+
+#endif // SOFTPWM_H
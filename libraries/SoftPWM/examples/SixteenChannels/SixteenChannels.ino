@@ -0,0 +1,43 @@
+/* Fades 16 LEDs at once in a wave with SoftPWM and prints how much of the CPU the PWM
+ * interrupt takes every second. Pins 0 and 1 are left for serial.
+ */
+#define SOFTPWM_PROFILE
+#include <SoftPWM.h>
+
+const int NUM_LEDS = 16;
+const int LEDS[NUM_LEDS] = {2,3,4,5,6,7,8,9,10,11,12,13,A0,A1,A2,A3};
+const int STEP_TIME = 10; // milliseconds between brightness steps
+const unsigned long REPORT_TIME = 1000;
+
+unsigned long last_step = 0, last_report = 0;
+uint8_t phase = 0;
+
+
+void setup() {
+  Serial.begin(115200);
+
+  for (int i = 0; i < NUM_LEDS; i++)
+    softPWMAttach(LEDS[i]);
+  softPWMBegin();
+}
+
+void loop() {
+  unsigned long now = millis();
+
+  if (now - last_step >= STEP_TIME) {
+    last_step = now;
+    phase++;
+
+    // a triangle wave, each LED a 16th of the way behind the one before
+    for (int i = 0; i < NUM_LEDS; i++) {
+      uint8_t t = phase + i * (256 / NUM_LEDS);
+      softPWMWrite(LEDS[i], t < 128 ? t * 2 : (255 - t) * 2);
+    }
+  }
+
+  if (now - last_report >= REPORT_TIME) {
+    last_report = now;
+    Serial.print("PWM interrupt load % ");
+    Serial.println(softPWMLoad());
+  }
+}
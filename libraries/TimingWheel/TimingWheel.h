@@ -0,0 +1,208 @@
+/* A hashed timing wheel that runs all of the sketch's periodic and one shot jobs.
+ * Every job hangs off the slot its deadline hashes to (deadline tick % WHEEL_SLOTS) with a
+ * count of how many more times the wheel has to go around before it is due. Scheduling is
+ * a push onto the front of a slot and each tick only looks at one slot, so both are O(1)
+ * in the number of jobs. All storage is a fixed table, nothing is allocated.
+ */
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include <Arduino.h>
+#include <avr/sleep.h>
+
+#define WHEEL_TICK_MS 10 // resolution of the wheel
+#define WHEEL_SLOTS 32   // slots in one revolution, must be a power of 2
+#ifndef WHEEL_MAX_JOBS
+#define WHEEL_MAX_JOBS 8 // jobs that can be scheduled at once
+#endif
+#define WHEEL_NONE -1
+
+struct WheelJob {
+  const char* name;
+  void (*callback)();
+  unsigned long period;       // ms between runs, 0 for one shot jobs
+  unsigned long due;          // millis() the job should run at
+  unsigned int rounds;        // revolutions left before the job is due
+  int8_t next;                // next job in the same slot
+  bool active;
+
+  // statistics
+  unsigned long runs;
+  unsigned long total_jitter; // ms, sum of how late every run started
+  unsigned int max_jitter;    // ms, latest start
+  unsigned long max_run;      // us, longest callback
+  unsigned int overruns;      // runs that started after the following run was already due
+  unsigned long busy;         // us spent in the callback, for whoever is adding up CPU use to clear
+};
+
+WheelJob wheel_jobs[WHEEL_MAX_JOBS];
+int8_t wheel_slots[WHEEL_SLOTS];   // first job in each slot
+unsigned int wheel_tick = 0;       // slot the wheel is on
+unsigned long wheel_tick_time = 0; // millis() of the current tick
+unsigned long wheel_due_at = 0;    // millis() the next job is due, while wheel_due_known
+bool wheel_due_known = false;      // cleared whenever a job moves
+
+
+// Hang a job off the slot for its deadline
+void wheelInsert(int8_t id) {
+  WheelJob& job = wheel_jobs[id];
+  long away = (long)(job.due - wheel_tick_time);
+  unsigned long ticks = away <= 0 ? 1 : (away + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+  byte slot = (wheel_tick + ticks) & (WHEEL_SLOTS - 1);
+
+  job.rounds = (ticks - 1) / WHEEL_SLOTS;
+  job.next = wheel_slots[slot];
+  wheel_slots[slot] = id;
+  wheel_due_known = false;
+}
+
+// Empty the wheel and start it turning from now
+void wheelBegin() {
+  for (byte s = 0; s < WHEEL_SLOTS; s++)
+    wheel_slots[s] = WHEEL_NONE;
+  for (byte j = 0; j < WHEEL_MAX_JOBS; j++)
+    wheel_jobs[j].active = false;
+
+  wheel_tick = 0;
+  wheel_tick_time = millis();
+  wheel_due_known = false;
+}
+
+// Run `callback` in `first` ms and then every `period` ms if period isn't 0.
+// Returns the job id or WHEEL_NONE if the job table is full.
+int8_t wheelSchedule(const char* name, void (*callback)(), unsigned long first, unsigned long period=0) {
+  for (int8_t id = 0; id < WHEEL_MAX_JOBS; id++) {
+    if (wheel_jobs[id].active)
+      continue;
+
+    WheelJob& job = wheel_jobs[id];
+    job = WheelJob();
+    job.name = name;
+    job.callback = callback;
+    job.period = period;
+    job.due = millis() + first;
+    job.active = true;
+    wheelInsert(id);
+    return id;
+  }
+
+  return WHEEL_NONE;
+}
+
+// Shorthand for a job that runs every `period` ms starting one period from now
+int8_t wheelEvery(const char* name, void (*callback)(), unsigned long period) {
+  return wheelSchedule(name, callback, period, period);
+}
+
+// Run every job in the current slot that has come around for the last time
+void wheelRunSlot() {
+  byte slot = wheel_tick & (WHEEL_SLOTS - 1);
+  int8_t id = wheel_slots[slot];
+  int8_t keep = WHEEL_NONE; // jobs that need more revolutions
+  wheel_slots[slot] = WHEEL_NONE;
+  wheel_due_known = false;  // a job kept back may be due on the next revolution now
+
+  while (id != WHEEL_NONE) {
+    WheelJob& job = wheel_jobs[id];
+    int8_t next = job.next;
+
+    if (job.rounds > 0) {
+      job.rounds--;
+      job.next = keep;
+      keep = id;
+    } else {
+      unsigned long now = millis();
+      unsigned long late = now - job.due;
+      unsigned long start = micros();
+      job.callback();
+      unsigned long ran = micros() - start;
+
+      job.runs++;
+      job.total_jitter += late;
+      job.max_jitter = max(job.max_jitter, (unsigned int)late);
+      job.max_run = max(job.max_run, ran);
+      job.busy += ran;
+
+      if (job.period == 0) {
+        job.active = false;
+      } else {
+        job.due += job.period;
+        // skip any runs we already missed rather than running them back to back
+        if ((long)(millis() - job.due) >= 0) {
+          job.overruns++;
+          job.due = millis() + job.period;
+        }
+        wheelInsert(id);
+      }
+    }
+
+    id = next;
+  }
+
+  // put the waiting jobs back, inserting may have already added to this slot
+  while (keep != WHEEL_NONE) {
+    int8_t next = wheel_jobs[keep].next;
+    wheel_jobs[keep].next = wheel_slots[slot];
+    wheel_slots[slot] = keep;
+    keep = next;
+  }
+}
+
+// Turn the wheel up to the current time, running everything that is due
+void wheelRun() {
+  while (millis() - wheel_tick_time >= WHEEL_TICK_MS) {
+    wheel_tick_time += WHEEL_TICK_MS;
+    wheel_tick++;
+    wheelRunSlot();
+  }
+}
+
+// ms until the next slot that has a job due on this revolution, at most one revolution
+unsigned long wheelNextDue() {
+  for (byte t = 1; t <= WHEEL_SLOTS; t++) {
+    for (int8_t id = wheel_slots[(wheel_tick + t) & (WHEEL_SLOTS - 1)]; id != WHEEL_NONE; id = wheel_jobs[id].next) {
+      if (wheel_jobs[id].rounds == 0) {
+        long wait = (long)(wheel_tick_time + t * WHEEL_TICK_MS - millis());
+        return wait > 0 ? wait : 0;
+      }
+    }
+  }
+  return (unsigned long)WHEEL_SLOTS * WHEEL_TICK_MS;
+}
+
+// Idle the CPU until the next interrupt if nothing is due. This doesn't sleep until the next
+// job: timer 0's millis() interrupt wakes it every 1.024 ms, so an idle loop still goes around
+// about 1000 times a second and only spends the rest of each tick idle instead of spinning.
+// Anything that can't wait for the next job (the IR receiver, serial) is seen at once either way.
+// The next deadline is kept between calls, so those wakes are a compare and not a scan of every
+// slot.
+void wheelSleep() {
+  if (!wheel_due_known) {
+    wheel_due_at = millis() + wheelNextDue();
+    wheel_due_known = true;
+  }
+  if ((long)(millis() - wheel_due_at) >= 0)
+    return;
+
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_mode();
+}
+
+// Print the jitter and overrun statistics of every job
+void wheelReport() {
+  Serial.println("Job        runs  avg/max jitter ms  max run us  overruns");
+  for (byte id = 0; id < WHEEL_MAX_JOBS; id++) {
+    WheelJob& job = wheel_jobs[id];
+    if (!job.active)
+      continue;
+
+    Serial.print(job.name); Serial.print("  ");
+    Serial.print(job.runs); Serial.print("  ");
+    Serial.print(job.runs ? job.total_jitter / job.runs : 0); Serial.print("/");
+    Serial.print(job.max_jitter); Serial.print("  ");
+    Serial.print(job.max_run); Serial.print("  ");
+    Serial.println(job.overruns);
+  }
+}
+
+#endif // TIMINGWHEEL_H
@@ -0,0 +1,243 @@
+/* Runs several apps on one board, each written as if it had the board to itself.
+ *
+ * An app is a namespace holding its state, a setup() and an AppManifest of what it uses of the
+ * board: its pins, the pins it puts PWM out on, the timers it or its libraries set up for
+ * themselves and the EEPROM it keeps. APP_CHECK compares every manifest with every other one at
+ * compile time, so two apps can't end up on one pin, timer or piece of EEPROM.
+ *
+ * Nothing blocks. Instead of a loop() with a delay() in it an app's setup() schedules its jobs
+ * on the shared timing wheel with appEvery(), and each job is charged to the app that scheduled
+ * it. appReport() (or an 'A' over serial) prints every app's share of the CPU, the latest any of
+ * its jobs started and how many runs it missed, which says whether there's room for one more.
+ *
+ * Serial is the runtime's. It runs the ConfigStore.h console for the apps' settings, which the
+ * sketch puts in one table and loads with configBegin(), and hands every one letter command to
+ * the apps.
+ */
+#ifndef APP_RUNTIME_H
+#define APP_RUNTIME_H
+
+#include <Arduino.h>
+
+#ifndef WHEEL_MAX_JOBS
+#define WHEEL_MAX_JOBS 12
+#endif
+#include <TimingWheel.h>
+#include <ConfigStore.h>
+
+// Timers an app can take, one bit each
+#define APP_TIMER0 0x01 // millis() and delay(), always the runtime's
+#define APP_TIMER1 0x02
+#define APP_TIMER2 0x04
+#define APP_TIMER3 0x08 // timers 3 to 5 are only on a Mega
+#define APP_TIMER4 0x10
+#define APP_TIMER5 0x20
+
+#define APP_MAX 8                  // apps the runtime can run
+#define APP_REPORT_INTERVAL 30000  // print the CPU shares every this many ms
+
+// What an app uses of the board
+struct AppManifest {
+  const char* name;
+  const uint8_t* pins;   // every pin the app uses
+  uint8_t pin_count;
+  const uint8_t* pwm;    // the ones it analogWrite()s, their timers have to be left as they are
+  uint8_t pwm_count;
+  uint8_t timers;        // APP_TIMER bits, the timers the app or its libraries set up themselves
+  uint16_t eeprom_start; // EEPROM bytes the app keeps, from start up to end
+  uint16_t eeprom_end;
+};
+
+// An app as the runtime runs it
+struct App {
+  const AppManifest* manifest;
+  void (*setup)();          // schedules the app's jobs with appEvery()
+  bool (*command)(char c);  // acts on a serial command or returns false if it isn't the app's, can be NULL
+};
+
+// The runtime itself, as a manifest to check the apps against: serial is on 0 and 1 and the
+// settings are at the end of the EEPROM
+constexpr uint8_t APP_RUNTIME_PINS[] = {0, 1};
+constexpr AppManifest APP_RUNTIME = {"runtime", APP_RUNTIME_PINS, 2, nullptr, 0, APP_TIMER0,
+                                     CONFIG_START, CONFIG_START + CONFIG_SIZE};
+
+
+// Compile time checks of the manifests
+
+// The timer behind analogWrite() on a pin, 0 if it has no PWM
+constexpr uint8_t appPwmTimer(uint8_t pin) {
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+  return pin == 4 || pin == 13 ? APP_TIMER0 : pin == 11 || pin == 12 ? APP_TIMER1 :
+         pin == 9 || pin == 10 ? APP_TIMER2 : pin == 2 || pin == 3 || pin == 5 ? APP_TIMER3 :
+         pin >= 6 && pin <= 8 ? APP_TIMER4 : pin >= 44 && pin <= 46 ? APP_TIMER5 : 0;
+#else
+  return pin == 5 || pin == 6 ? APP_TIMER0 : pin == 9 || pin == 10 ? APP_TIMER1 :
+         pin == 3 || pin == 11 ? APP_TIMER2 : 0;
+#endif
+}
+
+// Times pin is in a list
+constexpr uint8_t appCount(const uint8_t* list, uint8_t n, uint8_t pin) {
+  return n == 0 ? 0 : (list[0] == pin) + appCount(list + 1, n - 1, pin);
+}
+
+constexpr uint8_t appPinUses(const AppManifest* apps, uint8_t n, uint8_t pin) {
+  return n == 0 ? 0 : appCount(apps[0].pins, apps[0].pin_count, pin) + appPinUses(apps + 1, n - 1, pin);
+}
+
+constexpr bool appPinsApart(const AppManifest* apps, uint8_t n, uint8_t pin = 0) {
+  return pin == NUM_DIGITAL_PINS || (appPinUses(apps, n, pin) <= 1 && appPinsApart(apps, n, pin + 1));
+}
+
+constexpr bool appListValid(const uint8_t* list, uint8_t n) {
+  return n == 0 || (list[0] < NUM_DIGITAL_PINS && appListValid(list + 1, n - 1));
+}
+
+constexpr bool appPinsValid(const AppManifest* apps, uint8_t n) {
+  return n == 0 || (appListValid(apps[0].pins, apps[0].pin_count) && appPinsValid(apps + 1, n - 1));
+}
+
+// Every PWM pin has a timer and is one of the app's pins
+constexpr bool appPwmListValid(const AppManifest& app, const uint8_t* list, uint8_t n) {
+  return n == 0 || (appPwmTimer(list[0]) && appCount(app.pins, app.pin_count, list[0]) &&
+                    appPwmListValid(app, list + 1, n - 1));
+}
+
+constexpr bool appPwmValid(const AppManifest* apps, uint8_t n) {
+  return n == 0 || (appPwmListValid(apps[0], apps[0].pwm, apps[0].pwm_count) && appPwmValid(apps + 1, n - 1));
+}
+
+constexpr uint8_t appPwmTimers(const uint8_t* list, uint8_t n) {
+  return n == 0 ? 0 : appPwmTimer(list[0]) | appPwmTimers(list + 1, n - 1);
+}
+
+// Timers every app but the one at `skip` takes or puts PWM out on
+constexpr uint8_t appTimersUsed(const AppManifest* apps, uint8_t n, uint8_t skip) {
+  return n == 0 ? 0 :
+    (skip == 0 ? 0 : apps[0].timers | appPwmTimers(apps[0].pwm, apps[0].pwm_count)) |
+    appTimersUsed(apps + 1, n - 1, skip - 1);
+}
+
+constexpr bool appTimersApart(const AppManifest* apps, uint8_t n, uint8_t i = 0) {
+  return i == n || ((apps[i].timers & appTimersUsed(apps, n, i)) == 0 && appTimersApart(apps, n, i + 1));
+}
+
+constexpr bool appEepromOverlaps(const AppManifest& a, const AppManifest& b) {
+  return a.eeprom_start < a.eeprom_end && b.eeprom_start < b.eeprom_end &&
+         a.eeprom_start < b.eeprom_end && b.eeprom_start < a.eeprom_end;
+}
+
+constexpr bool appEepromApartFrom(const AppManifest& app, const AppManifest* apps, uint8_t n) {
+  return n == 0 || (!appEepromOverlaps(app, apps[0]) && appEepromApartFrom(app, apps + 1, n - 1));
+}
+
+constexpr bool appEepromApart(const AppManifest* apps, uint8_t n) {
+  return n == 0 || (apps[0].eeprom_end <= E2END + 1 && appEepromApartFrom(apps[0], apps + 1, n - 1) &&
+                    appEepromApart(apps + 1, n - 1));
+}
+
+// Check a constexpr array of manifests, APP_RUNTIME and every app's
+#define APP_CHECK(manifests) \
+  static_assert(sizeof(manifests) / sizeof(manifests[0]) <= APP_MAX + 1, "too many apps, raise APP_MAX"); \
+  static_assert(appPinsValid(manifests, sizeof(manifests) / sizeof(manifests[0])), \
+                "an app uses a pin this board doesn't have"); \
+  static_assert(appPinsApart(manifests, sizeof(manifests) / sizeof(manifests[0])), \
+                "two apps use the same pin, or one lists a pin twice"); \
+  static_assert(appPwmValid(manifests, sizeof(manifests) / sizeof(manifests[0])), \
+                "an app puts PWM out on a pin without a timer, or on one that isn't in its pins"); \
+  static_assert(appTimersApart(manifests, sizeof(manifests) / sizeof(manifests[0])), \
+                "an app takes a timer another app takes or puts PWM out on"); \
+  static_assert(appEepromApart(manifests, sizeof(manifests) / sizeof(manifests[0])), \
+                "two apps keep the same EEPROM, or one keeps more than there is")
+
+
+// Running the apps
+const App* app_list;
+uint8_t app_count = 0;
+uint8_t app_current = 0;             // app being set up, app_count for the runtime's own jobs
+uint8_t app_of_job[WHEEL_MAX_JOBS];  // app each job on the wheel is charged to
+unsigned long app_report_time = 0;   // millis() of the last report
+
+// Run `callback` every `period` ms for the app being set up, like wheelEvery()
+int8_t appEvery(const char* name, void (*callback)(), unsigned long period) {
+  int8_t id = wheelEvery(name, callback, period);
+  if (id == WHEEL_NONE) {
+    Serial.print(F("  No room on the wheel for ")); Serial.println(name);
+  } else {
+    app_of_job[id] = app_current;
+  }
+  return id;
+}
+
+// Print every app's share of the CPU since the last report, the latest any of its jobs has
+// started (ms after it was due) and how many runs were skipped because they were too late
+void appReport() {
+  unsigned long now = millis();
+  unsigned long span = max(now - app_report_time, 1UL);
+  app_report_time = now;
+
+  unsigned long total = 0;
+  Serial.println(F("App        cpu %  jobs  max late ms  overruns"));
+  for (uint8_t a = 0; a <= app_count; a++) {
+    unsigned long busy = 0;
+    unsigned int late = 0, overruns = 0;
+    uint8_t jobs = 0;
+    for (uint8_t id = 0; id < WHEEL_MAX_JOBS; id++) {
+      WheelJob& job = wheel_jobs[id];
+      if (!job.active || app_of_job[id] != a)
+        continue;
+      busy += job.busy;
+      job.busy = 0;
+      late = max(late, job.max_jitter);
+      overruns += job.overruns;
+      jobs++;
+    }
+    total += busy;
+
+    Serial.print(a < app_count ? app_list[a].manifest->name : APP_RUNTIME.name); Serial.print("  ");
+    Serial.print(busy / (span * 10.0), 1); Serial.print("  ");
+    Serial.print(jobs); Serial.print("  ");
+    Serial.print(late); Serial.print("  ");
+    Serial.println(overruns);
+  }
+  Serial.print(F("free  "));
+  Serial.println(100 - min(total / (span * 10.0), 100.0), 1);
+}
+
+// Give a serial command to the first app that wants it
+void appCommand(char c) {
+  if (c == 'A') {
+    appReport();
+    return;
+  }
+  for (uint8_t a = 0; a < app_count; a++)
+    if (app_list[a].command && app_list[a].command(c))
+      return;
+  Serial.print(F("Unknown command ")); Serial.println(c);
+}
+
+// Set every app up in turn, call from setup()
+void appBegin(const App* apps, uint8_t count) {
+  app_list = apps;
+  app_count = min(count, (uint8_t)APP_MAX);
+  wheelBegin();
+
+  for (app_current = 0; app_current < app_count; app_current++) {
+    Serial.print(F("Starting ")); Serial.println(apps[app_current].manifest->name);
+    apps[app_current].setup();
+  }
+  appEvery("report", appReport, APP_REPORT_INTERVAL);
+  app_report_time = millis();
+}
+
+// Act on serial commands and settings, run any jobs that are due and idle until the next, call
+// from loop()
+void appRun() {
+  char c = configPoll(Serial);
+  if (c)
+    appCommand(c);
+  wheelRun();
+  wheelSleep();
+}
+
+#endif // APP_RUNTIME_H
@@ -0,0 +1,58 @@
+/* The climate display from task4.4 as an app.
+ *
+ * The readings, statistics pages, EEPROM log, IR remote and settings are ClimateDisplay.h's, the
+ * same code the sketch runs. task4.4 already ran its work as jobs on the timing wheel, so they
+ * move over as they are. The queued IR presses, which task4.4 handles every pass of the loop, are
+ * handled by a job every wheel tick instead.
+ */
+#ifndef CLIMATE_APP_H
+#define CLIMATE_APP_H
+
+#define CLIMATE_NAME "climate: "
+#include <ClimateDisplay.h>
+#include "app_runtime.h"
+
+namespace climate {
+
+constexpr uint8_t DHT_PIN = 2;
+constexpr uint8_t IR_PIN = 3;
+constexpr uint8_t LCD_RS = 33;
+constexpr uint8_t LCD_E = 35;
+constexpr uint8_t LCD_D4 = 37;
+constexpr uint8_t LCD_D5 = 39;
+constexpr uint8_t LCD_D6 = 41;
+constexpr uint8_t LCD_D7 = 43;
+constexpr uint8_t LCD_CONTRAST = 7;
+constexpr uint8_t LCD_CONTRAST_INPUT = A2;
+
+constexpr uint8_t PINS[] = {DHT_PIN, IR_PIN, LCD_RS, LCD_E, LCD_D4, LCD_D5, LCD_D6, LCD_D7, LCD_CONTRAST,
+                            LCD_CONTRAST_INPUT};
+constexpr uint8_t PWM[] = {LCD_CONTRAST};
+// IRremote receives off timer 2 on a Mega, the settings are kept with the runtime's
+constexpr AppManifest MANIFEST = {"climate", PINS, sizeof(PINS), PWM, sizeof(PWM), APP_TIMER2,
+                                  LOG_START, LOG_START + LOG_PAGES * LOG_PAGE_SIZE};
+
+DHT_Unified DHTDevice(DHT_PIN, DHT11);
+Adafruit_LiquidCrystal LCD(LCD_RS, LCD_E, LCD_D4, LCD_D5, LCD_D6, LCD_D7);
+
+
+// 'D' dumps the log
+bool command(char c) {
+  if (c != 'D')
+    return false;
+  logDump(Serial);
+  return true;
+}
+
+void setup() {
+  pinMode(DHT_PIN, INPUT);
+  climateBegin(LCD, DHTDevice, LCD_CONTRAST, LCD_CONTRAST_INPUT);
+  climateIRBegin(IR_PIN);
+
+  appEvery("ir", climateIRDispatch, WHEEL_TICK_MS);
+  climateSchedule(appEvery);
+}
+
+} // namespace climate
+
+#endif // CLIMATE_APP_H
@@ -0,0 +1,68 @@
+/* The keypad lock from task5/5.2.cpp as an app.
+ *
+ * The states, codes, settings and servo moves are KeypadLock.h's, the same code the sketch runs.
+ * The loop's delay(100) is now the period of the one job, and the servo is moved from the Timer1
+ * interrupt by ServoMotion.h, so the job never waits for it.
+ */
+#ifndef LOCK_APP_H
+#define LOCK_APP_H
+
+#include <Keypad.h>
+#define LOCK_NAME "lock "
+#include <KeypadLock.h>
+#include "app_runtime.h"
+
+namespace lock {
+
+#define LOCK_ROW_PINS 22, 24, 26, 28
+#define LOCK_COL_PINS 30, 32, 34, 36
+constexpr uint8_t RED_LED = 38;
+constexpr uint8_t GREEN_LED = 40;
+constexpr uint8_t WHITE_LED = 42;
+constexpr uint8_t SERVO_PIN = 44;
+constexpr uint8_t POT_PIN = A0;
+
+constexpr uint8_t PINS[] = {LOCK_ROW_PINS, LOCK_COL_PINS, RED_LED, GREEN_LED, WHITE_LED, SERVO_PIN, POT_PIN};
+// ServoMotion takes timer 1, its settings are kept with the runtime's
+constexpr AppManifest MANIFEST = {"lock", PINS, sizeof(PINS), nullptr, 0, APP_TIMER1, 0, 0};
+
+const unsigned long STEP = 100; // ms between runs of the state machine
+
+char keys[4][4] = {
+  {'1', '2', '3', 'A'},
+  {'4', '5', '6', 'B'},
+  {'7', '8', '9', 'C'},
+  {'*', '0', '#', 'D'}
+};
+byte row_pins[4] = {LOCK_ROW_PINS};
+byte col_pins[4] = {LOCK_COL_PINS};
+Keypad keypad = Keypad(makeKeymap(keys), row_pins, col_pins, 4, 4);
+
+
+// Take any key press and run one step of the state machine
+void step() {
+  char key = keypad.getKey();
+  if (key)
+    lockKey(key);
+  lockStep(analogRead(POT_PIN));
+}
+
+void setup() {
+  pinMode(RED_LED, OUTPUT);
+  pinMode(GREEN_LED, OUTPUT);
+  pinMode(WHITE_LED, OUTPUT);
+  pinMode(POT_PIN, INPUT);
+  servoAttach(SERVO_PIN, LOCK_LOCKED_ANGLE);
+
+  appEvery("lock", step, STEP);
+}
+
+} // namespace lock
+
+// The lights, for KeypadLock.h
+void lockLight(uint8_t light, bool on) {
+  static const uint8_t pins[] = {lock::RED_LED, lock::GREEN_LED, lock::WHITE_LED}; // LOCK_RED etc.
+  digitalWrite(pins[light], on);
+}
+
+#endif // LOCK_APP_H
@@ -0,0 +1,76 @@
+/* The microwave from task5/5.4.cpp as an app.
+ *
+ * The states, buttons, settings and light ring are Microwave.h's, the same code the sketch runs.
+ * The state machine already ran off millis(), so the loop's delay(LOOP_DELAY) just becomes the
+ * period of its job. The ring goes out of USART1 with PixelUSART.h, a light at a time from its
+ * interrupts, rather than from Adafruit_NeoPixel::show(), which would turn interrupts off for the
+ * whole ring, about 360 us. That would stretch the lock's servo pulses from Timer1 and lose the
+ * IR receiver's Timer2 ticks.
+ */
+#ifndef MICROWAVE_APP_H
+#define MICROWAVE_APP_H
+
+#define MICROWAVE_NAME "microwave "
+#include <Microwave.h>
+#define PIXEL_COUNT MICROWAVE_RING_SIZE
+#include <PixelUSART.h>
+#include "app_runtime.h"
+
+namespace microwave {
+
+constexpr uint8_t POT_PIN = A1;          // potentiometer
+constexpr uint8_t STARTPAUSE_PIN = 23;   // start/pause button
+constexpr uint8_t STOP_PIN = 25;         // stop button
+constexpr uint8_t INTERLOCK_PIN = 27;    // the door interlock that stops the microwave if door is opened
+constexpr uint8_t MICROWAVE_PIN = 29;    // the relay for the motor and magnetron
+constexpr uint8_t LED_RING_PIN = 18;     // the LED ring, on USART1's TX
+static_assert(LED_RING_PIN == PIXEL_PIN, "the ring is on the USART's TX pin");
+
+constexpr uint8_t PINS[] = {POT_PIN, STARTPAUSE_PIN, STOP_PIN, INTERLOCK_PIN, MICROWAVE_PIN, LED_RING_PIN};
+// the ring takes USART1, TX1 and XCK1, which isn't broken out, but no timer. The settings are
+// kept with the runtime's
+constexpr AppManifest MANIFEST = {"microwave", PINS, sizeof(PINS), nullptr, 0, 0, 0, 0};
+
+const unsigned long STEP = 20; // ms between runs of the state machine
+
+
+
+// Read the inputs and run one step of the state machine
+void step() {
+  int pot = analogRead(POT_PIN);
+  bool start_pause = digitalRead(STARTPAUSE_PIN);
+  bool stop = digitalRead(STOP_PIN);
+  bool interlock = digitalRead(INTERLOCK_PIN);
+  microwaveStep(pot, start_pause, stop, interlock);
+  pixelDone(); // sends the ring again if another interrupt broke it
+}
+
+void setup() {
+  pinMode(POT_PIN, INPUT);
+  pinMode(STARTPAUSE_PIN, INPUT);
+  pinMode(STOP_PIN, INPUT);
+  pinMode(INTERLOCK_PIN, INPUT);
+  pinMode(MICROWAVE_PIN, OUTPUT);
+
+  pixelBegin();
+  microwaveBegin();
+
+  appEvery("microwave", step, STEP);
+}
+
+} // namespace microwave
+
+// The relay and the ring, for Microwave.h
+void microwaveRelay(bool on) {
+  digitalWrite(microwave::MICROWAVE_PIN, on);
+}
+
+void microwaveRing(uint8_t i, uint32_t colour) {
+  pixelSet(i, colour);
+}
+
+void microwaveRingShow() {
+  pixelShow();
+}
+
+#endif // MICROWAVE_APP_H
@@ -0,0 +1,46 @@
+/* The keypad lock (task5/5.2.cpp), the microwave (task5/5.4.cpp) and the climate display
+ * (task4.4) running together on one Arduino Mega.
+ *
+ * Each is an app in its own namespace, with its own state and a manifest of the pins, timers
+ * and EEPROM it uses, see app_runtime.h. The manifests are checked against each other below, so
+ * moving one app onto another's pin or timer won't compile. All of the apps' work runs as jobs
+ * on one timing wheel, nothing waits in a delay().
+ *
+ * Serial commands:
+ *   A  print every app's share of the CPU, also printed every 30 s
+ *   D  dump the climate app's EEPROM log for host/log_decode
+ * and the settings console for the lock's codes, the microwave's times and the climate display's
+ * intervals, the same as the sketches': list, get <name>, set <name> <value>, commit, revert or
+ * erase.
+ */
+#include "app_runtime.h"
+#include "lock_app.h"
+#include "microwave_app.h"
+#include "climate_app.h"
+
+constexpr AppManifest MANIFESTS[] = {APP_RUNTIME, lock::MANIFEST, microwave::MANIFEST, climate::MANIFEST};
+APP_CHECK(MANIFESTS);
+
+// Every app's settings, kept by the runtime
+constexpr ConfigParam CONFIG[] PROGMEM = {LOCK_CONFIG, MICROWAVE_CONFIG, CLIMATE_CONFIG};
+CONFIG_CHECK(CONFIG);
+
+const App APPS[] = {
+  {&lock::MANIFEST, lock::setup, nullptr},
+  {&microwave::MANIFEST, microwave::setup, nullptr},
+  {&climate::MANIFEST, climate::setup, climate::command},
+};
+
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("Starting..."));
+  if (configBegin(CONFIG, sizeof(CONFIG) / sizeof(CONFIG[0])))
+    Serial.println(F("Using the saved settings"));
+  appBegin(APPS, sizeof(APPS) / sizeof(APPS[0]));
+  Serial.println(F("Done"));
+}
+
+void loop() {
+  appRun();
+}
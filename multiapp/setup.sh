@@ -0,0 +1,4 @@
+#!/usr/bin/bash
+
+alias compile='arduino-cli compile --fqbn arduino:avr:mega --libraries libraries multiapp'
+alias upload='arduino-cli upload -p /dev/ttyACM0 --fqbn arduino:avr:mega multiapp'
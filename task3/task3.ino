@@ -1,14 +1,19 @@
 /* Author: Terrence Plunkett
  * Date: 2021-02-04
  *
- * Should improve upon by utilizing a game loop structure for state changes.
- * That is, the loop should not wait while doing an action on one LED. This
- * limits the number of concurrent changes to one LED and its inefficient.
- * But with other classes I didn't get past designing a better loop in time.
+ * Each LED runs its own little program of steps (fade to a brightness over some time, hold,
+ * blink, wait for another LED) and every LED moves along its program a little each tick of
+ * the loop, so the loop never waits on one LED and any number of them can change at once.
+ * Fades are worked out when a program is loaded so a tick is only integer additions.
+ *
+ * The LEDs are dimmed by SoftPWM (libraries/SoftPWM) rather than analogWrite(), so they can be
+ * on any digital pin, not just the PWM ones. The PWM interrupt's CPU use is printed to serial.
  */
+#define SOFTPWM_PROFILE
+#include <SoftPWM.h>
 
 
-// Pins for the various LEDs
+// Pins for the various LEDs, any digital pin but 0 and 1 (serial) will do.
 const int LED_A = 9;
 const int LED_B = 10;
 const int LED_C = 11;
@@ -28,83 +33,241 @@ const int BLINK_DELAY = 500;
 // Wait for how long before restarting the pattern.
 const int RESTART_DELAY = 4000;
 
+// How long a full fade takes going `inc` at a time.
+#define FADE_TIME(inc) ((255 + (inc) - 1) / (inc) * FADE_DELAY)
+
+// Print the PWM interrupt's CPU use this often, in milliseconds.
+const unsigned long REPORT_TIME = 5000;
+
+// Every LED moves along its program this often, in milliseconds.
+const int TICK = 10;
+
+// Most steps in one LED's program.
+const int MAX_STEPS = 12;
+
+// Signals LEDs can wait on each other with.
+const int NUM_SIGNALS = 4;
+
+
+// What a step does.
+enum Op {
+  SET,      // set the brightness to `value` straight away
+  FADE,     // fade from the current brightness to `value` over `time` ms
+  HOLD,     // stay as is for `time` ms
+  BLINK,    // turn off for `time` ms then back on for `time` ms, `value` times
+  SIGNAL,   // raise signal `value`
+  WAIT_FOR, // wait until signal `value` has been raised this time through the program
+  REPEAT    // start the program again
+};
+
+struct Step {
+  Op op;
+  int value;
+  unsigned int time;
+};
+
+// Where an LED is in its program.
+struct Channel {
+  int pin;
+  const Step* program;
+  int length;
+  int inc[MAX_STEPS];   // for FADE steps, brightness change per tick in 1/256ths
+  int step;
+  unsigned int level;   // brightness in 1/256ths
+  unsigned int ticks;   // ticks left in this step
+  int phases;           // for BLINK steps, half blinks left
+  unsigned int pass;    // times through the program
+};
 
-/* Fade an LED at PWM pin `id` from `start` to `end` brightness in `inc` increments with `wait` milliseconds
- * between each increment.
+
+// The pattern. LED_B fades down, then LED_A blinks three times, then LED_C fades up, then
+// they reset and wait to go again. Drop the WAIT_FORs and they would all go at once.
+const Step PROGRAM_A[] = {
+  {SET, 255},
+  {WAIT_FOR, 0},
+  {BLINK, 3, BLINK_DELAY},
+  {SIGNAL, 1},
+  {WAIT_FOR, 2},
+  {SET, 255},
+  {HOLD, 0, RESTART_DELAY},
+  {REPEAT},
+};
+const Step PROGRAM_B[] = {
+  {SET, 255},
+  {HOLD, 0, DELAY_START},
+  {FADE, 0, FADE_TIME(FADE_INC)},
+  {HOLD, 0, 2 * FADE_DELAY},
+  {SIGNAL, 0},
+  {WAIT_FOR, 2},
+  {SET, 255},
+  {HOLD, 0, RESTART_DELAY},
+  {REPEAT},
+};
+const Step PROGRAM_C[] = {
+  {SET, 0},
+  {WAIT_FOR, 1},
+  {FADE, 255, FADE_TIME(5)},
+  {SIGNAL, 2},
+  {SET, 0},
+  {HOLD, 0, RESTART_DELAY},
+  {REPEAT},
+};
+
+// A program and its length, checking at compile time that it fits in a channel's inc[]
+template <size_t N>
+constexpr int programLength(const Step (&)[N]) {
+  static_assert(N <= MAX_STEPS, "a program has more steps than MAX_STEPS");
+  return N;
+}
+#define PROGRAM(p) p, programLength(p)
+
+Channel channels[] = {
+  {LED_A, PROGRAM(PROGRAM_A)},
+  {LED_B, PROGRAM(PROGRAM_B)},
+  {LED_C, PROGRAM(PROGRAM_C)},
+};
+const int NUM_CHANNELS = sizeof(channels) / sizeof(channels[0]);
+
+// How many times each signal has been raised.
+unsigned int signals[NUM_SIGNALS];
+
+// millis() of the last tick and report.
+unsigned long last_tick = 0, last_report = 0;
+
+
+/* Work out the per tick change of every fade in a channel's program. A fade starts from
+ * wherever the steps before it left the LED, which for these programs is always known.
  */
-void fade(int id, int start, int end, int inc=FADE_INC, int wait=FADE_DELAY) {
-  int brightness = start;
-
-  // fade up or down depending on start and end.
-  if (end > start) {
-    inc = abs(inc);
-  } else if (end < start) {
-    inc = -abs(inc);
-  } else {
-    return;
-  }
+void channelLoad(Channel& ch) {
+  int brightness = 0;
 
-  // delay, increment, write
-  while (brightness != end) {
-    delay(wait);
+  for (int s = 0; s < ch.length; s++) {
+    const Step& step = ch.program[s];
+    ch.inc[s] = 0;
 
-    // don't increment past the end value.
-    if (abs(brightness - end) < abs(inc)) {
-      brightness = end;
-    } else {
-      brightness += inc;
+    if (step.op == SET) {
+      brightness = step.value;
+    } else if (step.op == FADE) {
+      long ticks = max(1u, step.time / TICK);
+      ch.inc[s] = ((long)(step.value - brightness) << 8) / ticks;
+      brightness = step.value;
     }
-    
-    analogWrite(id, brightness);
   }
 
-  if (inc < 0)
-    delay(wait);
+  ch.step = 0;
+  ch.level = 0;
+  ch.pass = 0;
+  channelStart(ch);
 }
 
-// Fade an LED down from 255 to 0 brightness.
-void fade_down(int id, int inc=FADE_INC) {
-  fade(id, 255, 0, inc=inc);
+void channelWrite(Channel& ch) {
+  softPWMWrite(ch.pin, ch.level >> 8);
 }
 
-// Fade an LED up from 0 to 255 brightness.
-void fade_up(int id, int inc=FADE_INC) {
-  fade(id, 0, 255, inc=inc);
+// Set up the step the channel just moved on to.
+void channelStart(Channel& ch) {
+  const Step& step = ch.program[ch.step];
+  ch.ticks = step.time / TICK;
+
+  if (step.op == BLINK)
+    ch.phases = step.value * 2;
 }
 
-// Blink an ON LED to OFF for wait milliseconds.
-void blink_off(int id, int wait=BLINK_DELAY) {
-  digitalWrite(id, LOW);
-  delay(wait);
-  digitalWrite(id, HIGH);
-  delay(wait);
+void channelNext(Channel& ch) {
+  ch.step++;
+  channelStart(ch);
 }
 
-// Setup the initial LED state.
-void initial_leds() {
-  digitalWrite(LED_A, HIGH);
-  digitalWrite(LED_B, HIGH);
-  digitalWrite(LED_C, LOW);
+/* Move a channel along by one tick. Steps that take no time are all done in the same tick,
+ * but never more than a program's worth so a program of only those can't lock up the loop.
+ */
+void channelTick(Channel& ch) {
+  for (int done = 0; done < ch.length; done++) {
+    const Step& step = ch.program[ch.step];
+
+    switch (step.op) {
+    case SET:
+      ch.level = step.value << 8;
+      channelWrite(ch);
+      channelNext(ch);
+      continue;
+
+    case SIGNAL:
+      signals[step.value]++;
+      channelNext(ch);
+      continue;
+
+    case WAIT_FOR:
+      if (signals[step.value] <= ch.pass)
+        return;
+      channelNext(ch);
+      continue;
+
+    case REPEAT:
+      ch.pass++;
+      ch.step = 0;
+      channelStart(ch);
+      continue;
+
+    case FADE:
+      if (ch.ticks > 1) {
+        ch.ticks--;
+        ch.level += ch.inc[ch.step];
+      } else {
+        // land exactly on the target whatever rounding did
+        ch.level = step.value << 8;
+        channelNext(ch);
+      }
+      channelWrite(ch);
+      return;
+
+    case HOLD:
+      if (ch.ticks > 0)
+        ch.ticks--;
+      if (ch.ticks == 0)
+        channelNext(ch);
+      return;
+
+    case BLINK:
+      if (ch.ticks > 0)
+        ch.ticks--;
+      if (ch.ticks == 0) {
+        ch.phases--;
+        ch.ticks = step.time / TICK;
+      }
+      // blinks start with the off half and end back on
+      softPWMWrite(ch.pin, ch.phases % 2 == 0 && ch.phases > 0 ? 0 : ch.level >> 8);
+      if (ch.phases == 0)
+        channelNext(ch);
+      return;
+    }
+  }
 }
 
-// Configure LED pins and set their initial state.
+// Configure LED pins and load every LED's program.
 void setup() {
-  pinMode(LED_A, OUTPUT);
-  pinMode(LED_B, OUTPUT);
-  pinMode(LED_C, OUTPUT);
+  Serial.begin(115200);
+
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    softPWMAttach(channels[c].pin);
+    channelLoad(channels[c]);
+  }
+  softPWMBegin();
 
-  initial_leds();
+  last_tick = last_report = millis();
 }
 
 void loop() {
-  delay(DELAY_START);
-  fade_down(LED_B);
-  delay(100);
-  blink_off(LED_A);
-  blink_off(LED_A);
-  blink_off(LED_A);
-  fade_up(LED_C, 5);
-
-  initial_leds();
-  delay(RESTART_DELAY);
+  if (millis() - last_tick >= TICK) {
+    last_tick += TICK;
+
+    for (int c = 0; c < NUM_CHANNELS; c++)
+      channelTick(channels[c]);
+  }
+
+  if (millis() - last_report >= REPORT_TIME) {
+    last_report += REPORT_TIME;
+    Serial.print("PWM interrupt load % ");
+    Serial.println(softPWMLoad());
+  }
 }
@@ -1,4 +1,4 @@
 #!/usr/bin/bash
 
-alias compile='arduino-cli compile --fqbn arduino:avr:uno task3'
-alias upload='arduino-cli upload -p /dev/ttyACM0 --fqbn arduino:avr:uno task3'
+alias compile='arduino-cli compile --fqbn arduino:avr:uno --libraries libraries task4.3'
+alias upload='arduino-cli upload -p /dev/ttyACM0 --fqbn arduino:avr:uno task4.3'
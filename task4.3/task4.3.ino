@@ -3,20 +3,32 @@
  *
  * Sets the light up level of a 10 segment LED display utilizing the output from a
  * depth sensor.
+ *
+ * The depth sensor is pinged continuously without waiting on it. The echo is timed by a pin
+ * change interrupt while the loop keeps the bar refreshed, and the bar is updated from the
+ * newest reading at DISPLAY_RATE.
  */
 
 
+// Pins resolved at compile time, from libraries/
+#include <FastPin.h>
+
+
 // Global Constants
 const int NUM_LEDS = 10;
-const int LEDS[NUM_LEDS] = {2,3,4,5,6,7,8,9,10,11};
-const int DEPTH_PINS[2] = {12,13}; // Echo, Trigger.
-const int PING_TIME = 60; // milliseconds to measure distance over. >= 29.
-
-// Predeclare a function so I can put it in any order I wish.
-// This isn't done for all functions because the compiler didn't ask me to.
-// While it should be, I'm not sure why the compiler disallowed one function
-// and not the others.
-float getDistance(int delayBetweenPings=100);
+#define LED_PINS 2,3,4,5,6,7,8,9,10,11
+const int LEDS[NUM_LEDS] = {LED_PINS};
+typedef PinGroup<LED_PINS> BarPins;
+typedef Pin<12> EchoPin;
+typedef Pin<13> TriggerPin;
+static_assert(EchoPin::port == PIN_PORT_B, "the echo pin has to be on PORTB (8-13) for PCINT0");
+static_assert(!BarPins::onPort(PIN_PORT_C), "the bar is only written to PORTD and PORTB");
+static_assert(PinLayout<BarPins, EchoPin, TriggerPin, Pin<0>, Pin<1> >::distinct, "the bar, the sensor and serial (0 and 1) each need their own pins");
+const int PING_TIME = 60; // milliseconds between pings, the HC-SR04 needs 60 for old echoes to die down. >= 29.
+const unsigned long ECHO_TIMEOUT = 40; // milliseconds to give up on an echo, the sensor's "nothing there" pulse is 38.
+const int DISPLAY_RATE = 50; // times per second to update the bar from the newest reading.
+const unsigned long REPORT_TIME = 1000; // milliseconds between printing the achieved rates.
+const int BAR_STEPS = 16; // brightness steps of the partly lit LED at the end of the bar.
 
 
 // Global Variables
@@ -24,106 +36,178 @@ float getDistance(int delayBetweenPings=100);
 float percent = 0;
 // Are we lighting up (false) or turning off (true)?
 bool direction = false;
+// Newest distance reading in cm.
+float distance = 0;
+
+// Ranging, the echo times are written by the pin change interrupt.
+volatile unsigned long echo_start = 0; // micros() the echo went HIGH, 0 when not in an echo
+volatile unsigned long echo_time = 0;  // microseconds the last echo was HIGH for
+volatile bool echo_ready = false;      // whether echo_time is a new reading
+bool pinging = false;                  // whether we are waiting on an echo
+unsigned long ping_time = 0;           // millis() of the last ping
+
+// Rate reporting
+unsigned long last_display = 0, last_report = 0;
+unsigned int samples = 0, displays = 0, misses = 0;
+
+// The bar is written straight to the port registers. These are the bits of
+// PORTD and PORTB for each number of lit LEDs. The LEDs light when their pin is LOW.
+uint8_t bar_d[NUM_LEDS + 1], bar_b[NUM_LEDS + 1];
+const uint8_t bar_mask_d = BarPins::mask_d, bar_mask_b = BarPins::mask_b; // every LED's bit
+int bar_shown = -1;                     // number of LEDs lit right now
+unsigned int bar_level = 0;             // what the bar should show, in 1/BAR_STEPS of an LED
+unsigned int bar_error = 0;             // dithering error carried between refreshes
 
 
 // Configure pin modes
 void setup() {
-  /*Serial.begin(115200);
-  Serial.print("Starting...       ");*/
+  Serial.begin(115200);
+  Serial.print("Starting...       ");
   
-  for (int i = 0; i < NUM_LEDS; i++)
-    pinMode(LEDS[i], OUTPUT);
-  // Serial.println("Done");
+  BarPins::output();
+  barSetup();
 
-  pinMode(DEPTH_PINS[0], INPUT);
-  pinMode(DEPTH_PINS[1], OUTPUT);
+  EchoPin::input();
+  TriggerPin::output();
+  rangingSetup();
+  Serial.println("Done");
 }
 
 
 // Update the 10 segment LED to match the distance measured.
 // Currently maps the range 0-10cm to the display, anything more is just all on.
 void loop() {
-  float distance = getDistance(PING_TIME);
+  unsigned long now = millis();
+  ranging();
+
+  if (now - last_display >= 1000 / DISPLAY_RATE) {
+    last_display = now;
+    percent = map(distance, 0, 10, 0, 100);
+    setPercent(percent);
+    displays++;
+  }
+  barRefresh();
+
+  if (now - last_report >= REPORT_TIME) {
+    last_report = now;
+    Serial.print("Readings/s "); Serial.print(samples * 1000.0 / REPORT_TIME);
+    Serial.print(" missed echoes/s "); Serial.print(misses * 1000.0 / REPORT_TIME);
+    Serial.print(" bar updates/s "); Serial.println(displays * 1000.0 / REPORT_TIME);
+    samples = displays = misses = 0;
+  }
+}
+
 
-  percent = map(distance, 0, 10, 0, 100);
-  setPercent(percent);
+// Work out the port bits for every level of the bar.
+void barSetup() {
+  // LEDs from `lit` onwards are off (HIGH)
+  for (int lit = 0; lit <= NUM_LEDS; lit++) {
+    bar_d[lit] = bar_b[lit] = 0;
+    for (int i = lit; i < NUM_LEDS; i++) {
+      if (digitalPinToPort(LEDS[i]) == PD)
+        bar_d[lit] |= digitalPinToBitMask(LEDS[i]);
+      else
+        bar_b[lit] |= digitalPinToBitMask(LEDS[i]);
+    }
+  }
 }
 
 
-// Sets the LED at LEDS[l] to `mode`.
-void setLED(unsigned int l, bool mode) {
-  if (l >= NUM_LEDS)
-    return;
-  if (l < 0)
+// Light the first `lit` LEDs with one write to each port, only if that isn't already shown.
+void barWrite(int lit) {
+  if (lit == bar_shown)
     return;
-  
-  /*Serial.print(i);
-  Serial.print(", ");
-  Serial.println(mode);*/
-  digitalWrite(LEDS[i], mode);  
+
+  uint8_t sreg = SREG;
+  cli(); // the serial and depth sensor pins share these ports
+  PORTD = (PORTD & ~bar_mask_d) | bar_d[lit];
+  PORTB = (PORTB & ~bar_mask_b) | bar_b[lit];
+  SREG = sreg;
+  bar_shown = lit;
+}
+
+
+// Show the bar. The LED at the end of the bar is dithered on and off to show the
+// fraction of it that should be lit, so this should be called as often as possible.
+void barRefresh() {
+  int lit = bar_level / BAR_STEPS;
+
+  bar_error += bar_level % BAR_STEPS;
+  if (bar_error >= BAR_STEPS) {
+    bar_error -= BAR_STEPS;
+    lit++;
+  }
+  barWrite(lit);
 }
 
 
 // Sets that percent of the LEDs to on and the rest to off.
 void setPercent(float percent) {
-  unsigned int leds = map(percent, 0, 100, 0, NUM_LEDS);
-  /*Serial.print("Percent mapped to ");
-  Serial.print(percent);
-  Serial.print("->");
-  Serial.println(leds);*/
-
-  for (unsigned int l=0; l < NUM_LEDS; l++) {
-    if (l < leds)
-      setLED(l, LOW);
-    else
-      setLED(l, HIGH);
-  }  
+  bar_level = constrain(percent, 0, 100) * (NUM_LEDS * BAR_STEPS) / 100;
+  barRefresh();
 }
 
-//-----------------------------------------------
-//retunrs a distance reading from an attached 
-//HC_SR04 ultrasong sensor
-//param: delpayBetweenPings will default to 100
-//       if left blank. 
-//       Smallest value should be 29.
-// Written by Jordan Kidney, borrowed from example code for week 5 of COMP 3012 in Winter of 2021.
-float getDistance(int delayBetweenPings=100)
-{
-  unsigned long pingTime;
-  float distance;
- 
-  //clear trigger pin
-  digitalWrite(DEPTH_PINS[1], LOW);
-  delayMicroseconds(2);
-  
-  //make the trig pin output High for 10 microseconds
-  //to trigger the HC_SR04
-  digitalWrite(DEPTH_PINS[1], HIGH);
-  delayMicroseconds(10);
-  digitalWrite(DEPTH_PINS[1], LOW);
- 
-  //wait for the HC_SR04 to return a HIGH level
-  //signal and measure how long it took to get a  
-  //signal back.
-  pingTime = pulseIn(DEPTH_PINS[0], HIGH); 
-  
-  //calculate distance based upon pingTime based upon
-  //known speed of sound
-  
-  //seed of sound ( v = 340 m/s = 0.034 cm/ microsecond)
-  
-  distance = pingTime*0.034/2;
 
+// Turn on the pin change interrupt for the echo pin.
+void rangingSetup() {
+  *digitalPinToPCMSK(EchoPin::number) |= _BV(digitalPinToPCMSKbit(EchoPin::number));
+  *digitalPinToPCICR(EchoPin::number) |= _BV(digitalPinToPCICRbit(EchoPin::number));
+}
+
+
+// Time the echo pulse as it happens instead of waiting in pulseIn().
+ISR(PCINT0_vect) {
+  unsigned long now = micros();
+
+  if (EchoPin::read()) {
+    echo_start = now;
+  } else if (echo_start != 0) {
+    echo_time = now - echo_start;
+    echo_start = 0;
+    echo_ready = true;
+  }
+}
 
-  //if distance goes above 400, just assume a large
-  //objects is closer than 2cm (the min)
 
-  if(distance > 400) distance = 0;
-             
-  //wait delayBetweenPings between next
-  //reading, a delay is needed to stop problems
-  //with trying to read ultrasonic too fast.
-  //Min should be 29.
-  delay(delayBetweenPings);
-  return distance;                  
+// Pick up a finished echo and send the next ping when it is time. Never waits on the sensor.
+// Based on getDistance() by Jordan Kidney, from example code for week 5 of COMP 3012 in Winter of 2021.
+void ranging() {
+  unsigned long now = millis();
+
+  if (echo_ready) {
+    noInterrupts();
+    unsigned long time = echo_time;
+    echo_ready = false;
+    interrupts();
+
+    //speed of sound ( v = 340 m/s = 0.034 cm/ microsecond)
+    distance = time*0.034/2;
+
+    //if distance goes above 400, just assume a large
+    //objects is closer than 2cm (the min)
+    if(distance > 400) distance = 0;
+
+    samples++;
+    pinging = false;
+  } else if (pinging && now - ping_time >= ECHO_TIMEOUT) {
+    // no echo, keep the last reading. echo_start is 4 bytes the ISR also writes, so it's cleared
+    // with interrupts off like echo_time is read above
+    noInterrupts();
+    echo_start = 0;
+    interrupts();
+    pinging = false;
+    misses++;
+  }
+
+  // a ping has to wait out PING_TIME from the last one for old echoes to die down
+  if (!pinging && now - ping_time >= PING_TIME) {
+    ping_time = now;
+    pinging = true;
+
+    //make the trig pin output High for 10 microseconds
+    //to trigger the HC_SR04
+    TriggerPin::high();
+    delayMicroseconds(10);
+    TriggerPin::low();
+  }
 }
@@ -2,22 +2,25 @@
  * Date: 2021-02-18
  *
  * Utilizes a DHT11 humidity sensor, an LCD display, an IR receiver and remote, and a 10K potentiometer.
- * Potentiometer is used to control LCD contrast, LCD displays DHT11 readings, and IR remote turns on and off the LCD.
+ * Potentiometer is used to control LCD contrast, LCD displays DHT11 readings, and IR remote turns on and off the LCD,
+ * pages through the display and trims the contrast. Remote presses are queued from the receiver interrupt and
+ * handled on the next pass of the loop. The update intervals can be changed over serial while it runs and saved
+ * to the EEPROM, send "list" to see them.
  */
 
-// automated timer based events
-#include <Automaton.h>
+// timer based events, from libraries/
+#include <TimingWheel.h>
 
-// Usage of DHT sensor
-#include <DHT.h>
-#include <DHT_U.h>
-#include <Adafruit_Sensor.h>
+// history of the DHT readings in the EEPROM, from libraries/
+#define LOG_PAGES 30 // all but the last 64 bytes of the EEPROM, which hold the settings
+#include <SensorLog.h>
 
-// IR Receiver
-#include <IRremote.h>
+// settings changed over serial and kept in the EEPROM, from libraries/
+#include <ConfigStore.h>
+static_assert(LOG_START + LOG_PAGES * LOG_PAGE_SIZE <= CONFIG_START, "the log runs into the settings");
 
-// LCD Display
-#include <Adafruit_LiquidCrystal.h>
+// the display's readings, pages and remote, from libraries/
+#include <ClimateDisplay.h>
 
 
 // Global Variables
@@ -25,15 +28,9 @@
 #define DHT_PIN 2
 #define DHTTYPE DHT11
 DHT_Unified DHTDevice(DHT_PIN, DHTTYPE);
-sensor_t HumidSensor, TempSensor;
-Atm_timer DHTTimer;
-double humidity, temperature;
 
 // IR Receiver
 #define IR_PIN 3
-#define IR_CHECK_INTERVAL 600 // check for received codes every this many ms
-Atm_timer IRTimer;
-long last_press_time = 0; // time when button was last pressed
 
 // LCD Display
 #define LCD_RS 13
@@ -44,12 +41,14 @@ long last_press_time = 0; // time when button was last pressed
 #define LCD_D7 8
 #define LCD_CONTRAST 6
 #define LCD_CONTRAST_INPUT A0
-#define LCD_UPDATE_INTERVAL 2000
-#define LCD_CONTRAST_UPDATE_INTERVAL 400 // contrast updating
 Adafruit_LiquidCrystal LCD(LCD_RS, LCD_E, LCD_D4, LCD_D5, LCD_D6, LCD_D7);
-bool lcd_on = true;
-byte lcd_contrast = 0;
-Atm_timer LCDTimer, ContrastTimer;
+
+// Scheduling
+#define REPORT_INTERVAL 30000 // print the timing statistics every this many ms
+
+// Settings, "list" over serial shows them
+constexpr ConfigParam CONFIG[] PROGMEM = {CLIMATE_CONFIG};
+CONFIG_CHECK(CONFIG);
 
 
 // Configure pin modes and schedule callbacks
@@ -57,137 +56,33 @@ void setup() {
   Serial.begin(115200);
   Serial.println("Starting...");
 
-  LCDSetup();
-  IRSetup();
-  DHTSetup();
+  wheelBegin();
+  if (configBegin(CONFIG, sizeof(CONFIG) / sizeof(CONFIG[0])))
+    Serial.println("  Using the saved settings");
+  pinMode(DHT_PIN, INPUT);
+  climateBegin(LCD, DHTDevice, LCD_CONTRAST, LCD_CONTRAST_INPUT);
+  climateIRBegin(IR_PIN);
+  climateSchedule(wheelEvery);
+  wheelEvery("report", wheelReport, REPORT_INTERVAL);
 
   Serial.println("Done");
 }
 
-// do call backs via automaton
+// act on any IR presses and serial commands, run any jobs that are due, then sleep until something happens
 void loop() {
-  automaton.run();
-}
-
-
-// Start the LCD display and associated timer based callbacks
-void LCDSetup() {
-  pinMode(LCD_CONTRAST, OUTPUT);
-  pinMode(LCD_CONTRAST_INPUT, INPUT);
-
-  LCD.begin(16,2);
-  LCD.noBlink();
-  LCD.noCursor();
-
-  Serial.print("  Updating LCD every "); Serial.print(LCD_UPDATE_INTERVAL); Serial.println("ms");
-  LCDTimer.begin(LCD_UPDATE_INTERVAL)
-    .repeat(-1)
-    .onTimer(LCDUpdate)
-    .start();
-  Serial.print("  Updating LCD Contrast every "); Serial.print(LCD_CONTRAST_UPDATE_INTERVAL); Serial.println("ms");
-  ContrastTimer.begin(LCD_CONTRAST_UPDATE_INTERVAL)
-    .repeat(-1)
-    .onTimer(ContrastUpdate)
-    .start();
-}
-
-void ContrastUpdate() {
-  // Set contrast
-  lcd_contrast = map(analogRead(LCD_CONTRAST_INPUT), 0, 1023, 0, 255);
-  analogWrite(LCD_CONTRAST, lcd_contrast);
-}
-
-// Writes the temperature and humidity out to the display
-void LCDUpdate() {
-  LCD.setCursor(0, 0);
-  LCD.print("                ");
-  LCD.setCursor(0, 0);
-  LCD.print("Humid ");
-  LCD.print(String(humidity));
-  LCD.setCursor(0, 1);
-  LCD.print("                ");
-  LCD.setCursor(0, 1);
-  LCD.print("Temp ");
-  LCD.print(String(temperature));
-  LCD.setCursor(15,1);
-}
-
-// turns on or off the LCD display (doesn't turn off the backlight)
-void toggleLCD() {
-  if (lcd_on) {
-    LCD.noDisplay();
-    lcd_on = false;
-  } else {
-    LCD.display();
-    lcd_on = true;
-  }
-}
-
-
-// Start the IR receiver and schedule timed callback
-void IRSetup() {
-  IrReceiver.begin(IR_PIN);
+  climateIRDispatch();
+  SerialCommand();
+  wheelRun();
 
-  Serial.print("  Checking IR Sensor every "); Serial.print(IR_CHECK_INTERVAL); Serial.println("ms");
-  IRTimer.begin(IR_CHECK_INTERVAL)
-    .repeat(-1)
-    .onTimer(IRUpdate)
-    .start();
+  if (!climateIRPending())
+    wheelSleep();
 }
 
-// Check for IR data and act on it
-void IRUpdate(int idx, int v, int up) {
-  if (IrReceiver.decode()) {
-    switch (IrReceiver.decodedIRData.command) {
-    case 0x44: // test
-      Serial.println("Pressed test");
-      break;
-    
-    case 69: // power
-      toggleLCD();
-      break;
-
-    default:
-      Serial.print("Pressed unused button "); Serial.println(IrReceiver.decodedIRData.command);
-    }
-
-    IrReceiver.resume();
+// Acts on single character commands sent over serial, other lines are settings commands
+void SerialCommand() {
+  switch (configPoll(Serial)) {
+  case 'D': // dump the log
+    logDump(Serial);
+    break;
   }
 }
-
-
-// Starts the DHT sensor and schedules a callback to save the value
-void DHTSetup() {
-  pinMode(DHT_PIN, INPUT);
-  
-  DHTDevice.begin();
-  DHTDevice.humidity().getSensor(&HumidSensor);
-
-  Serial.print("  Updating DHT Sensor every "); Serial.print(HumidSensor.min_delay / 1000); Serial.println("ms");
-  DHTTimer.begin(HumidSensor.min_delay / 1000)
-    .repeat(-1)
-    .onTimer(DHTUpdate)
-    .start();
-}
-
-// Retrieves the humitity and temperature data from the DHTDevice and saves to global variables
-void DHTUpdate(int idx, int v, int up) {
-  sensors_event_t event;
-  DHTDevice.humidity().getEvent(&event);
-
-  if (!isnan(event.relative_humidity)) {
-    humidity = event.relative_humidity;
-    //Serial.print("Updated humidity sensor "); Serial.println(humidity);
-  } else {
-    //Serial.println("Failed to read humidity sensor");
-  }
-
-  DHTDevice.temperature().getEvent(&event);
-
-  if (!isnan(event.temperature)) {
-    temperature = event.temperature;
-    // Serial.print("Updated temperature sensor "); Serial.println(humidity);
-  } else {
-    // Serial.println("Failed to read temperature sensor");
-  }
-}
\ No newline at end of file
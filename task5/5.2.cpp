@@ -2,12 +2,15 @@
 NOTE: Keys must be pressed with a slight delay, do not press the keys fast or 
 the device int he simulator will nto work properly
 
-Oprn serial monitor to see output
+Oprn serial monitor to see output. The codes below and the pot windows are the
+defaults, send "list" over serial to see what they are now and "set" to change them
 
 Starts in the Locked state
 
   (1) RED led will be on in locked state (Servo will be at 90 deg)
   (2) GREEN led will be on in unlocked state (Servo will be at 0 deg)
+      the servo takes half a second to get there and codes are only
+      checked once it has
   (3) all three leds will cycle in hypnotic state
   (4) When locked if 1324 has been enetred then the machine will
       go inot unlocked mode. (Servo will be at previouse state from transition)
@@ -19,11 +22,45 @@ Starts in the Locked state
   (7) in hypnotic state if 2 is enetred machine will go into locked state
   (8) in hypnotic state if 3 is enetred machine will go into locked state 
  
+ The states themselves are in libraries/KeypadLock/KeypadLock.h, which
+ multiapp's lock app runs as well.
  
  Keypad library: https://playground.arduino.cc/Code/Keypad/
  ===============================================================================*/
 #include <Keypad.h>
-#include <Servo.h>
+
+//----------------------------------------------------------------
+// Pins worked out at compile time, from libraries/
+#include <FastPin.h>
+
+// tables of names in flash, from libraries/
+#include <FlashString.h>
+
+// settings changed over serial and kept in the EEPROM, from libraries/
+#include <ConfigStore.h>
+
+// the lock's state machine, shared with multiapp's lock app, from libraries/. It moves the
+// servo from the Timer1 interrupt with ServoMotion.h
+#include <KeypadLock.h>
+
+// "#M" lines of how much RAM is used, from libraries/
+//#define MEMORY_REPORT
+#include <MemoryReport.h>
+
+// "#T" lines of every input read, for host/replay, from libraries/
+//#define TRACE
+#include <InputTrace.h>
+
+// where the time goes, from libraries/. Define PROFILE and send a 'P' to print "#S" lines for
+// host/profile.py, there's no Timer2 to sample from on the host
+//#define PROFILE
+#if defined(PROFILE) && defined(__AVR__)
+#include <SampleProfiler.h>
+#else
+#define profilerBegin()
+#define profilerDump(out)
+#define profilerUpdate(out)
+#endif
 
 //----------------------------------------------------------------
 //Keypad info
@@ -36,444 +73,91 @@ char keys[4][4] = {
   {'*', '0', '#','D'}
 };
 //note can not have a row or col on pin 13 for this to work
-byte rowPins[4] = {12,11,10,9}; //first 4 lines from left side
-byte colPins[4] = {8,7,6,5}; // next 4 lines 
+#define ROW_PINS 12,11,10,9 //first 4 lines from left side
+#define COL_PINS 8,7,6,5 // next 4 lines 
+byte rowPins[4] = {ROW_PINS};
+byte colPins[4] = {COL_PINS};
 byte potPin = A5;
+typedef PinLayout<PinGroup<ROW_PINS>, PinGroup<COL_PINS> > KeypadPins;
+static_assert(!KeypadPins::has(13), "can not have a row or col on pin 13, its LED holds the line down");
 
 Keypad myKeypad = Keypad(makeKeymap(keys), rowPins, colPins,4,4);
 
-const int BUFFER_SIZE = 20; //max number of key presses that 
-                             //can be stored at one time
-
-char keyBuffer[BUFFER_SIZE]; //array used to store queue of keys pressed
-int front = -1, rear = -1;
-int numKeysInQueue = 0;
-
-
-//---------------------------------------------------
-//State machine info
-//All states
-enum State 
-{ 
- LOCKED, 
- UNLOCKED,
- HYPNOTIC,
- SWEEP
-};
-//For debugging and easier readign states
-//Enter the string that should be printed for a state
-//in the sanme order as the ones from above
-char* stateNames[] = 
-{
- "Locked",
- "Unlocked",
- "Hypnotic",
- "Sweep"
-};
-boolean debug = true; // set to false to not show debug messages
-
-boolean printKeyBuffer = true; //false to not show key buffer 
-
-State currentState = LOCKED; // Set start state
 //----------------------------------------------------------------
 //Servo info
 const int SERVO_PIN = 3;
-Servo lockServo; 
 //----------------------------------------------------------------
 //Lights Info
 const int LED_r = 2;
 const int LED_g = 4;
 const int LED_w = 13;
+typedef Pin<LED_r> RedLed;
+typedef Pin<LED_g> GreenLed;
+typedef Pin<LED_w> WhiteLed;
+
+//every pin once, serial is on 0 and 1
+static_assert(PinLayout<KeypadPins, RedLed, GreenLed, WhiteLed, Pin<SERVO_PIN>, Pin<A5>, Pin<0>, Pin<1> >::distinct,
+              "two things are on the same pin");
+
+//----------------------------------------------------------------
+//Settings
+// Changed over serial while the sketch runs and kept in the EEPROM. A line starting with a
+// capital letter is one of the sketch's one letter commands as before, any other line is for the
+// console: list, get <name>, set <name> <value>, commit, revert or erase. The codes and pot
+// windows are the lock's, see KeypadLock.h.
+constexpr ConfigParam CONFIG[] PROGMEM = {LOCK_CONFIG};
+CONFIG_CHECK(CONFIG);
 
 //----------------------------------------------------------------
 void setup()
 {
+  memoryPaint();
   Serial.begin(9600);
-  printDebugMessage("Machine starting up");
+  lockDebug(F("Machine starting up"));
   
-  pinMode(LED_r, OUTPUT);
-  pinMode(LED_g, OUTPUT);
-  pinMode(LED_w, OUTPUT);
+  RedLed::output();
+  GreenLed::output();
+  WhiteLed::output();
   pinMode(potPin, INPUT);
   
-  lockServo.attach( SERVO_PIN );
+  servoAttach(SERVO_PIN, LOCK_LOCKED_ANGLE);
+  if (configBegin(CONFIG, sizeof(CONFIG) / sizeof(CONFIG[0])))
+    lockDebug(F("Using the saved settings"));
+  profilerBegin();
 }
 //----------------------------------------------------------------
 void loop()
 { 
-  saveAnyKeyPress();
+  traceLoop();
+  memoryReport();
+  if (configPoll(Serial) == 'P')
+    profilerDump(Serial);
+  profilerUpdate(Serial);
+
+  char key = traceKey(myKeypad.getKey());
+  if(key)
+    lockKey(key);
   
   //run one step of current state
-  runStateMachine();
+  lockStep(traceAnalog(potPin));
   
   delay(100); //here justy to mae sure simulation does nto go crazy 
              //if things are runing too fast
 }
-//---------------------------------------------------
-void printDebugMessage(char* msg)
-{
-  if(debug)
-  {
-    unsigned long myTime = millis();
-    Serial.print(myTime);
-    Serial.print(": (");
-    Serial.print( stateNames[ currentState ] );
-    Serial.print(") ");
-    Serial.println(msg);
-  }
-}
-void printDebugMessage(char msg) //overloaded function
-{
-  if(debug)
-  {
-    unsigned long myTime = millis();
-    Serial.print(myTime);
-    Serial.print(": (");
-    Serial.print( stateNames[ currentState ] );
-    Serial.print(") ");
-    Serial.println(msg);
-  }
-}
-//---------------------------------------------------
-void runStateMachine()
+//----------------------------------------------------------------
+//Lights for the lock's states
+void lockLight(uint8_t light, bool on)
 {
-  switch(currentState)
+  switch(light)
   {
-   case LOCKED: 
-    runLockedState();
-    break; 
-   case UNLOCKED: 
-    runUnlockedState();
+   case LOCK_RED:
+    RedLed::write(on);
     break;
-   case HYPNOTIC: 
-    runHypnoticState();
+   case LOCK_GREEN:
+    GreenLed::write(on);
     break;
-   case SWEEP:
-    runSweepState();
+   case LOCK_WHITE:
+    WhiteLed::write(on);
     break;
   }
 }
-//----------------------------------
-boolean locked_first_run = false;
-
-void runLockedState()
-{
-  //to not waste calls
-  //this code is only run the first time the state is enetred
-  if(locked_first_run == false)
-  {
-    lockDevice();
-    digitalWrite(LED_r, HIGH);
-    digitalWrite(LED_g, LOW);
-    digitalWrite(LED_w, LOW);
-    locked_first_run = true;
-  }
-  
-  //check for transitions
-  String sequence = getSequenceofKeys(4);
-  short pot = analogRead(potPin);
-  
-  //check to see if we have 4 keypresses yet for code
-  if(sequence.length() > 0)
-  {
-  
-    //check for proper code 
-    if(sequence == String("1234")) //hypnotic state
-    {
-      printDebugMessage("Changing to HYPNOTIC state");
-      currentState = HYPNOTIC;
-      locked_first_run = false; //reset for next time locked state is run
-    }
-    else if(sequence == String("1324") && pot <= 44 ) //unlock state
-    {
-      printDebugMessage("Changing to UNLOCKED state");
-      currentState = UNLOCKED;
-      locked_first_run = false; //reset for next time locked state is run
-    }
-    else 
-    {
-      //unkown code, do nothing. Code ehre just for debugging
-      printDebugMessage("Unknown code and potentiometer reading");
-      printDebugMessage((char*) sequence.c_str());
-      printDebugMessage((char*) String(pot).c_str());
-    }
-  } else if(91 <= pot && pot <= 110 ) //sweep state
-  {
-    printDebugMessage("Changing to SWEEP state");
-    currentState = SWEEP;
-    locked_first_run = false; //reset for next time locked state is run
-  }
-}
-//----------------------------------
-boolean unlocked_first_run = false;
-void runUnlockedState()
-{
-   //to not waste calls
-  //this code is only run the first time the state is enetred
-  if(unlocked_first_run == false)
-  {
-    unLockDevice();
-    digitalWrite(LED_r, LOW);
-    digitalWrite(LED_g, HIGH);
-    digitalWrite(LED_w, LOW);
-    unlocked_first_run = true;
-  }
-  
-  
-  //check for transitions
-  String sequence = getSequenceofKeys(4);
-  short pot = analogRead(potPin);
-  
-  //check to see if we have 4 keypresses yet for code
-  if(sequence.length() > 0)
-  {
-    //check for proper code 
-    if(sequence == String("1234")) //hypnotic state
-    {
-      printDebugMessage("Changing to HYPNOTIC state");
-      currentState = HYPNOTIC;
-      unlocked_first_run = false; //reset for next time unlocked state is run
-    }
-    else if(sequence == String("4231") && 45 <= pot && pot <= 90) //lock state
-    {
-      printDebugMessage("Changing to LOCKED state");
-      currentState = LOCKED;
-      unlocked_first_run = false; //reset for next time unlocked state is run
-    }
-    else 
-    {
-      //unkown code, do nothing. Code ehre just for debugging
-      printDebugMessage("Unknown code and potentiometer reading");
-      printDebugMessage((char*) sequence.c_str());
-      printDebugMessage((char*) String(pot).c_str());
-    }
-  }  
-}
-//----------------------------------
-int currentLED = 0;
-
-void runHypnoticState()
-{
-  
-  switch(currentLED)
-  {
-    case 0:  //RED LED ON
-     digitalWrite(LED_r, HIGH);
-     digitalWrite(LED_g, LOW);
-     digitalWrite(LED_w, LOW);
-     break;
-    case 1:  //GREEN LED ON
-     digitalWrite(LED_r, LOW);
-     digitalWrite(LED_g, HIGH);
-     digitalWrite(LED_w, LOW);
-     break;
-    case 2:  //WHITE LED ON    
-     digitalWrite(LED_r, LOW);
-     digitalWrite(LED_g, LOW);
-     digitalWrite(LED_w, HIGH);
-     break; 
-  }
-  
-  currentLED = (currentLED + 1) % 3;
-  delay(100);
-  
-    //check for transitions
-  String sequence = getSequenceofKeys(1);
-  
-  //check to see if we have 4 keypresses yet for code
-  if(sequence.length() > 0)
-  {
-    //check for proper code 
-    if(sequence == String("2")) //lock state
-    {
-      printDebugMessage("Changing to LOCKED state");
-      currentState = LOCKED;
-      currentLED = 0; //reset for next entry of hypnotic state
-    }
-    else if(sequence == String("3")) //unlock state
-     {
-      printDebugMessage("Changing to UNLOCKED state");
-      currentState = UNLOCKED;
-      currentLED = 0; //reset for next entry of hypnotic state
-    }
-    else if(sequence == String("4")) //sweep state
-     {
-      printDebugMessage("Changing to SWEEP state");
-      currentState = SWEEP;
-      currentLED = 0; //reset for next entry of hypnotic state
-    }
-    else 
-    {
-      //unkown code, do nothing. Code ehre just for debugging
-      printDebugMessage("Unknown code");
-      printDebugMessage((char*) sequence.c_str());
-    }
-    
-  }  
-}
-//----------------------------------------------------------------
-// I assume that "bliinking at the state time continuously" means they
-// blink on every state check loop rather than slower like hypnotic mode.
-// If this was not the intention I would add a lastToggle variable that
-// would store the time the lights mode was switched. Then if the difference
-// between that and the current time was > a constant defined at the top,
-// toggle the light states.
-bool ledState = false;
-
-void runSweepState() {
-  if (ledState) {
-    digitalWrite(LED_r, LOW);
-    digitalWrite(LED_g, LOW);
-  } else {
-    digitalWrite(LED_r, HIGH);
-    digitalWrite(LED_g, HIGH);
-  }
-  ledState = !ledState;
-  
-  //check for transitions
-  String sequence = getSequenceofKeys(4);
-  
-  //check to see if we have 4 keypresses yet for code
-  if(sequence.length() > 0)
-  {
-    //check for proper code 
-    if(sequence == String("4231")) //lock state
-    {
-      printDebugMessage("Changing to LOCKED state");
-      currentState = LOCKED;
-    }
-    else if(sequence == String("4321")) //hypnotic state
-     {
-      printDebugMessage("Changing to HYPNOTIC state");
-      currentState = HYPNOTIC;
-    }
-    else 
-    {
-      //unkown code, do nothing. Code here just for debugging
-      printDebugMessage("Unknown code");
-      printDebugMessage((char*) sequence.c_str());
-    }
-  } 
-}
-//----------------------------------------------------------------
-//Lock mecanism code, just a basic servo here
-void lockDevice()
-{
- lockServo.write(90); 
- delay(15);
-}
-//----------------------------
-void unLockDevice()
-{
- lockServo.write(0); 
- delay(15);
-}
-
-//----------------------------------------------------------------
-//Keypad functions
-//----------------------------------------------------------------
-void saveAnyKeyPress()
-{
-   char key = myKeypad.getKey();
-   if(key)
-   {
-      String msg = "Adding key: ";
-      msg = msg + key;
-      printDebugMessage((char*) msg.c_str());
-      enQueueKeyPress(key);
-     
-      if(printKeyBuffer)
-          printOutCurrentQueue();
-   }
-}
-//----------------------------------------------------------------
-//Returns numkeys seequence of keypresses form the internall keyBuffer
-//if there are nto enough keyprssses yet, it will return a string of length 
-//zero
-String getSequenceofKeys(int numKeys)
-{
-  String sequence = "";
-  
-  if(numKeys > 0 && numKeys <= numKeysInQueue)
-  {
-     for(int keys = 0; keys < numKeys; keys++)
-       sequence.concat( deQueueKeyPress() );
-    
-  }
-  
-  return sequence;
-}
-//----------------------------------------------------------------
-//Functions for keypad buffer that stores presses in a 
-//circular queue
-//for more info see: https://www.programiz.com/dsa/circular-queue
-// the following code was refereced from the website from above
-// Check if the queue is full
-//------------------------------------------
-int isFull() {
-  if ( (front == rear + 1) 
-       || (front == 0 && rear == BUFFER_SIZE - 1)
-     ) 
-     return 1;
-  
-  return 0;
-}
-//------------------------------------------
-// Check if the queue is empty
-int isEmpty() {
-  if (front == -1) return 1;
-  return 0;
-}
-//------------------------------------------
-// Adding an element
-void enQueueKeyPress(char element) {
-  if (isFull())
-    Serial.println("\n Keypad Queue is full!! \n");
-  else {
-    if (front == -1) front = 0;
-    rear = (rear + 1) % BUFFER_SIZE;
-    keyBuffer[rear] = element;
-    numKeysInQueue++;
-  }
-}
-//------------------------------------------
-// Removing an element
-char deQueueKeyPress() {
-  char element;
-  if (isEmpty()) return (-1);
-  else 
-  {
-    element = keyBuffer[front];
-   
-    if (front == rear) { //Queue is now empty
-      front = -1;
-      rear = -1;
-    } 
-    else 
-      front = (front + 1) % BUFFER_SIZE;
-   
-    numKeysInQueue--;
-    return (element);
-  }
-}
-//----------------------------------------------------------------
-void printOutCurrentQueue()
-{
-  if(debug)
-  {
-    String msg = "keyBuffer";
-  
-    if(isEmpty())
-      msg = "Queue is empty";
-    else
-    {
-      int i =0;
-      for (i = front; i != rear; i = (i + 1) % BUFFER_SIZE) 
-          msg = msg + "[" +  keyBuffer[i] + "]"; 
-      
-      msg = msg + "[" +  keyBuffer[i] + "]"; //last element
-    } 
-    
-    printDebugMessage((char*) msg.c_str() );
-  }
-}
@@ -1,3 +1,36 @@
+// Pins worked out at compile time, from libraries/
+#include <FastPin.h>
+
+// tables of names in flash, from libraries/
+#include <FlashString.h>
+
+// settings changed over serial and kept in the EEPROM, from libraries/
+#include <ConfigStore.h>
+
+// history of the distance and pot in the EEPROM, from libraries/
+#define LOG_PAGES 30 // all but the last 64 bytes of the EEPROM, which hold the settings
+#include <SensorLog.h>
+static_assert(LOG_START + LOG_PAGES * LOG_PAGE_SIZE <= CONFIG_START, "the log runs into the settings");
+
+// "#M" lines of how much RAM is used, from libraries/
+//#define MEMORY_REPORT
+#include <MemoryReport.h>
+
+// "#T" lines of every input read, for host/replay, from libraries/
+//#define TRACE
+#include <InputTrace.h>
+
+// where the time goes, from libraries/. Define PROFILE and send a 'P' to print "#S" lines for
+// host/profile.py, there's no Timer2 to sample from on the host
+//#define PROFILE
+#if defined(PROFILE) && defined(__AVR__)
+#include <SampleProfiler.h>
+#else
+#define profilerBegin()
+#define profilerDump(out)
+#define profilerUpdate(out)
+#endif
+
 // Global Variables
 enum State {
   A,
@@ -7,84 +40,206 @@ enum State {
   E,
   F
 };
-char* stateNames[] {
-  "A",
-  "B",
-  "C",
-  "D",
-  "E",
-  "F"
+// in flash, read one with flashString(stateNames, state)
+const char state_a[] PROGMEM = "A";
+const char state_b[] PROGMEM = "B";
+const char state_c[] PROGMEM = "C";
+const char state_d[] PROGMEM = "D";
+const char state_e[] PROGMEM = "E";
+const char state_f[] PROGMEM = "F";
+const char* const stateNames[] PROGMEM {
+  state_a,
+  state_b,
+  state_c,
+  state_d,
+  state_e,
+  state_f
 };
 
+#ifdef NO_DEBUG
+boolean debug = false; // the host fuzzer builds with NO_DEBUG
+#else
 boolean debug = true; // false to not show debug messages
+#endif
 State currentState = B; // start state
 #define LOOP_DELAY 80
 
 #define POT_PIN A5
-int DEPTH_PINS[] = {7,8};
+
+// Ultrasonic sensors as {echo, trigger}. With more than one they are pinged in turn, one per
+// loop, so one sensor can't hear another's echo.
+int DEPTH_PINS[][2] = {{7,8}};
+#define NUM_DEPTH_SENSORS (sizeof(DEPTH_PINS) / sizeof(DEPTH_PINS[0]))
+#define PING_GAP 60        // milliseconds between any two pings for old echoes to die down
+#define ECHO_TIMEOUT 25000 // microseconds to wait for an echo, about 4m there and back
+#define MAX_DISTANCE 400   // cm, the furthest the sensor can really see
+#define MEDIAN_SIZE 5      // readings in each sensor's median filter
+#define MAX_SPEED 200      // cm/s, a reading that implies faster movement is an outlier
+#define GATE_SLACK 5       // cm allowed on top of MAX_SPEED for sensor noise
+#define MAX_REJECTS 3      // outliers in a row before believing the object really moved
+
+// What the last ping of a sensor saw
+enum RangeStatus {
+  RANGE_NONE,     // no readings yet
+  RANGE_OK,       // a reading that went into the median
+  RANGE_REJECTED, // a reading too far from the median, the median still stands
+  RANGE_NO_ECHO   // nothing within range, not the same as something touching the sensor
+};
+const char range_none[] PROGMEM = "none";
+const char range_ok[] PROGMEM = "ok";
+const char range_rejected[] PROGMEM = "rejected";
+const char range_no_echo[] PROGMEM = "no echo";
+const char* const rangeNames[] PROGMEM {
+  range_none,
+  range_ok,
+  range_rejected,
+  range_no_echo
+};
+
+struct Range {
+  float window[MEDIAN_SIZE]; // the newest readings, oldest at `next`
+  float sorted[MEDIAN_SIZE]; // the same readings in order
+  byte next, count;
+  byte rejects;              // outliers in a row
+  unsigned long time;        // millis() of the last accepted reading
+  float distance;            // median of the window
+  RangeStatus status;
+};
+Range ranges[NUM_DEPTH_SENSORS];
+byte next_sensor = 0;       // sensor to ping next
+unsigned long last_ping = 0;
 
 // LEDs
 #define RED_PIN 6
 #define BLUE_PIN 5
 #define GREEN_PIN 3
-#define BLINK_TIME 1000 // toggle state every this many milliseconds
-#define FADE_TIME 2000 // fade entirely down or up in this amount of time
+typedef Pin<RED_PIN> RedLed; // faded, so it has to be a PWM pin
+typedef Pin<BLUE_PIN> BlueLed;
+typedef Pin<GREEN_PIN> GreenLed;
+static_assert(PinLayout<RedLed, BlueLed, GreenLed, Pin<POT_PIN>, Pin<0>, Pin<1> >::distinct,
+              "two things are on the same pin, serial is on 0 and 1");
+#define FADE_TIME 2000 // fade_time's default
 #define FADE_AMT 20
+unsigned int blink_time = 1000;      // toggle state every this many milliseconds
+unsigned int fade_time = FADE_TIME;  // fade entirely down or up in this amount of time
+unsigned int fade_step = FADE_TIME/(255/FADE_AMT); // ms between fade steps, kept up by fadeChanged()
 bool led_state = true; // for all states that utilize and LED to blink or fade
 int led_brightness = 0; // for states C, D, F to fade
 unsigned long last_change = millis();
 
+// Logging
+#define LOG_INTERVAL 30000 // save the distance and potentiometer to the EEPROM every this many milliseconds
+unsigned long last_log = 0;
+
+// Low power
+// Once the pot and the distance have stayed still for STILL_TIME the loop slows down to
+// IDLE_LOOP_DELAY, sleeping in between, until either moves again
+#define STILL_TIME 5000        // ms the inputs have to stay still before slowing down
+#define IDLE_LOOP_DELAY 480    // ms between loops while still, instead of LOOP_DELAY
+#define POT_NOISE 3            // the pot can wander this much without it counting as moved
+#define DISTANCE_NOISE 2       // cm the distance can wander without it counting as moved
+#define TELEMETRY_INTERVAL 10000 // print "#P" power telemetry every this many milliseconds
+#define CURRENT_AWAKE 9000     // uA the ATmega328P takes running at 16 MHz and 5 V
+#define CURRENT_IDLE 3500      // uA in idle sleep, with the timers still running for PWM
+#define CURRENT_DOWN 10        // uA in power down with only the watchdog running
+bool still = false;            // whether the loop has slowed down
+unsigned long still_since = 0; // millis() the inputs last moved
+short still_pot = -1;          // pot reading when the inputs last moved
+float still_distance[NUM_DEPTH_SENSORS];
+unsigned long telemetry_time = 0;           // millis() the telemetry was last printed
+unsigned long idle_time = 0, down_time = 0; // ms spent in each sleep mode since then
+
+
+// Settings
+// Changed over serial while the sketch runs and kept in the EEPROM. A line starting with a
+// capital letter is one of the sketch's one letter commands as before, any other line is for the
+// console: list, get <name>, set <name> <value>, commit, revert or erase.
+// Where the pot and the distance move the state machine between states
+short band_low = 25;     // A and B, B and E, E and B
+short band_mid = 90;     // A and E, B and C, C and B
+short band_high = 120;   // B and C, C and D
+short f_band_low = 20;   // F goes back to C below this
+short f_band_high = 40;  // and on to D between the two
+short near_cm = 20;      // an object this close moves D to F, and C only goes to D without one
+
+void fadeChanged();
+constexpr ConfigParam CONFIG[] PROGMEM = {
+  {"blink_time", CONFIG_U16, &blink_time, 20, 10000},
+  {"fade_time", CONFIG_U16, &fade_time, 255/FADE_AMT, 20000, fadeChanged},
+  {"band_low", CONFIG_I16, &band_low, 0, 1023},
+  {"band_mid", CONFIG_I16, &band_mid, 0, 1023},
+  {"band_high", CONFIG_I16, &band_high, 0, 1023},
+  {"f_band_low", CONFIG_I16, &f_band_low, 0, 1023},
+  {"f_band_high", CONFIG_I16, &f_band_high, 0, 1023},
+  {"near_cm", CONFIG_I16, &near_cm, 2, 400},
+};
+CONFIG_CHECK(CONFIG);
+
 
 // Helper functions for everyone
-void debugMsg(char* msg, char* data=NULL) {
-  if(debug) {
-    unsigned long myTime = millis();
-    Serial.print(myTime);
-    Serial.print(": (");
-    Serial.print(stateNames[currentState]);
-    Serial.print(") ");
-
-    if (data != NULL) {
-      Serial.print(msg);
-      Serial.println(data);
-    } else {
-      Serial.println(msg);
-    }
-  }
+// Print "<ms>: (<state>) <msg>", msg is an F("...") string
+void debugStart(const __FlashStringHelper* msg) {
+  Serial.print(millis());
+  Serial.print(F(": ("));
+  Serial.print(flashString(stateNames, currentState));
+  Serial.print(F(") "));
+  Serial.print(msg);
+}
+
+// and then data, anything Serial.print() takes, so numbers and flashString()s go straight out
+template <typename T>
+void debugMsg(const __FlashStringHelper* msg, T data) {
+  if (!debug)
+    return;
+  debugStart(msg);
+  Serial.println(data);
+}
+
+// and then "<data> <more>"
+template <typename T, typename U>
+void debugMsg(const __FlashStringHelper* msg, T data, U more) {
+  if (!debug)
+    return;
+  debugStart(msg);
+  Serial.print(data);
+  Serial.print(' ');
+  Serial.println(more);
+}
+
+void debugMsg(const __FlashStringHelper* msg) {
+  debugMsg(msg, "");
 }
 
 void changeState(State n); // this fixes the new Arduino build system declaration bug and allows enum arguments.
 void changeState(State n) {
   currentState = n;
-  debugMsg("Changing to state", stateNames[n]);
+  debugMsg(F("Changing to state"), flashString(stateNames, n));
 }
 
 //-----------------------------------------------
 //retunrs a distance reading from an attached
-//HC_SR04 ultrasong sensor
-//param: delpayBetweenPings will default to 100
-//       if left blank.
-//       Smallest value should be 29.
+//HC_SR04 ultrasong sensor, or -1 if there was no echo
 // Written by Jordan Kidney, borrowed from example code for week 5 of COMP 3012 in Winter of 2021.
-float getDistance(int delayBetweenPings=100)
+// Changed to take the sensor and to report no echo instead of 0.
+float getDistance(byte sensor)
 {
   unsigned long pingTime;
   float distance;
 
   //clear trigger pin
-  digitalWrite(DEPTH_PINS[1], LOW);
+  digitalWrite(DEPTH_PINS[sensor][1], LOW);
   delayMicroseconds(2);
 
   //make the trig pin output High for 10 microseconds
   //to trigger the HC_SR04
-  digitalWrite(DEPTH_PINS[1], HIGH);
+  digitalWrite(DEPTH_PINS[sensor][1], HIGH);
   delayMicroseconds(10);
-  digitalWrite(DEPTH_PINS[1], LOW);
+  digitalWrite(DEPTH_PINS[sensor][1], LOW);
 
   //wait for the HC_SR04 to return a HIGH level
   //signal and measure how long it took to get a
-  //signal back.
-  pingTime = pulseIn(DEPTH_PINS[0], HIGH);
+  //signal back. 0 if it took too long.
+  pingTime = tracePulse(DEPTH_PINS[sensor][0], HIGH, ECHO_TIMEOUT);
 
   //calculate distance based upon pingTime based upon
   //known speed of sound
@@ -93,43 +248,301 @@ float getDistance(int delayBetweenPings=100)
 
   distance = pingTime*0.034/2;
 
+  //nothing came back or it came back from further than
+  //the sensor can really see
+  if(pingTime == 0 || distance > MAX_DISTANCE) distance = -1;
 
-  //if distance goes above 400, just assume a large
-  //objects is closer than 2cm (the min)
+  return distance;
+}
 
-  if(distance > 400) distance = 0;
+// Put a reading into a sensor's median window in place of the oldest one.
+// Keeps `sorted` in order by moving the readings between the two, O(MEDIAN_SIZE).
+void rangeInsert(Range& range, float reading) {
+  byte i = range.count;
+
+  if (range.count == MEDIAN_SIZE) {
+    // take the oldest reading out of the sorted copy
+    float oldest = range.window[range.next];
+    for (i = 0; range.sorted[i] != oldest; i++);
+    for (; i + 1 < MEDIAN_SIZE; i++)
+      range.sorted[i] = range.sorted[i + 1];
+  } else {
+    range.count++;
+  }
 
-  //wait delayBetweenPings between next
-  //reading, a delay is needed to stop problems
-  //with trying to read ultrasonic too fast.
-  //Min should be 29.
-  // delay(delayBetweenPings);
-  return distance;
+  // slide bigger readings up to make room for this one
+  for (; i > 0 && range.sorted[i - 1] > reading; i--)
+    range.sorted[i] = range.sorted[i - 1];
+  range.sorted[i] = reading;
+
+  range.window[range.next] = reading;
+  range.next = (range.next + 1) % MEDIAN_SIZE;
+  range.distance = range.sorted[range.count / 2];
+}
+
+// Filter a reading from a sensor. Readings further from the median than the object could
+// have moved since the last good one are rejected, unless they keep coming.
+void rangeFilter(Range& range, float reading, unsigned long time) {
+  if (reading < 0) {
+    range.status = RANGE_NO_ECHO;
+    return;
+  }
+
+  float gate = MAX_SPEED * (time - range.time) / 1000.0 + GATE_SLACK;
+  bool outside = range.count > 0 && abs(reading - range.distance) > gate;
+  if (outside && range.rejects < MAX_REJECTS) {
+    range.rejects++;
+    range.status = RANGE_REJECTED;
+    return;
+  }
+
+  if (outside) {
+    // still out after MAX_REJECTS, the object really did move, forget where it was. A reading
+    // back inside the gate only means the rejects were spikes, and the history is kept.
+    range.count = 0;
+    range.next = 0;
+  }
+  range.rejects = 0;
+  range.time = time;
+  rangeInsert(range, reading);
+  range.status = RANGE_OK;
+}
+
+// Ping the next sensor, at most one ping every PING_GAP.
+void rangingUpdate() {
+  unsigned long time = millis();
+  if (time - last_ping < PING_GAP)
+    return;
+
+  last_ping = time;
+  rangeFilter(ranges[next_sensor], getDistance(next_sensor), time);
+  next_sensor = (next_sensor + 1) % NUM_DEPTH_SENSORS;
+}
+
+// Whether any sensor has an object closer than `cm`
+bool objectWithin(float cm) {
+  for (byte s = 0; s < NUM_DEPTH_SENSORS; s++) {
+    if (ranges[s].status != RANGE_NONE && ranges[s].status != RANGE_NO_ECHO && ranges[s].distance < cm)
+      return true;
+  }
+  return false;
+}
+
+// Whether every sensor either sees nothing or has an object further than `cm`
+bool objectBeyond(float cm) {
+  for (byte s = 0; s < NUM_DEPTH_SENSORS; s++) {
+    if (ranges[s].status == RANGE_NONE)
+      return false;
+    if (ranges[s].status != RANGE_NO_ECHO && ranges[s].distance <= cm)
+      return false;
+  }
+  return true;
+}
+
+
+
+// EEPROM sensor log
+// Send 'D' over serial to dump it for host/log_decode.
+
+// Save the distance and potentiometer to the log every LOG_INTERVAL
+void logUpdate(float distance, short pot) {
+  unsigned long time = millis();
+
+  if (time - last_log >= LOG_INTERVAL) {
+    last_log = time;
+    int16_t values[LOG_CHANNELS] = {(int16_t)distance, pot}; // -1 for no echo
+    logAppend(values, time);
+  }
+}
+
+
+
+// Low power
+// Sleeping is in power down, woken by the watchdog every 16 << k ms, unless a pin is putting out
+// PWM which would stop, then it's idle sleep woken by the millis() interrupt every ms. Timer0 is
+// stopped in power down so the time slept is added to millis() by hand. The watchdog is only
+// good to about 10%, so while still millis() drifts by up to that much. Serial can't wake it
+// from power down either, a 'D' sent while it's asleep may need sending again.
+#ifdef __AVR__
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+extern volatile unsigned long timer0_millis; // what millis() returns, from the Arduino core
+
+ISR(WDT_vect) {
+  // only here to wake up
+}
+
+// Power down for 16 << k ms
+void sleepDown(byte k) {
+  Serial.flush(); // the UART stops too
+
+  byte adc = ADCSRA;
+  ADCSRA = 0; // the ADC would keep drawing current
+  cli();
+  MCUSR &= ~_BV(WDRF);
+  WDTCSR = _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE) | (k & 8 ? _BV(WDP3) : 0) | (k & 7);
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  wdt_disable();
+  ADCSRA = adc;
+
+  cli();
+  timer0_millis += 16UL << k;
+  sei();
 }
 
+// Whether any timer is driving a pin with analogWrite()
+bool pwmRunning() {
+  return ((TCCR0A | TCCR1A | TCCR2A) & 0xf0) != 0;
+}
+#endif
+
+// Sleep for about ms, as deeply as it can
+void lowPowerSleep(unsigned long ms) {
+#ifdef __AVR__
+  if (pwmRunning()) {
+    unsigned long start = millis();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (millis() - start < ms) {
+      sleep_enable();
+      sleep_cpu();
+      sleep_disable();
+    }
+    idle_time += ms;
+    return;
+  }
+
+  for (byte k = 9; ms >= 16; ) {
+    if ((16UL << k) <= ms) {
+      sleepDown(k);
+      ms -= 16UL << k;
+      down_time += 16UL << k;
+    } else {
+      k--;
+    }
+  }
+#else
+  down_time += ms;
+#endif
+  delay(ms); // less than one watchdog step on an AVR
+}
+
+// ms until the current state next changes its LED
+unsigned long untilLedChange() {
+  unsigned long step = currentState == C || currentState == D || currentState == F ? fade_step : blink_time;
+  unsigned long since = millis() - last_change;
+  return since >= step ? 0 : step - since;
+}
+
+// Note whether the pot or any distance moved, call every loop after reading them
+void lowPowerUpdate(short pot) {
+  bool moved = abs(pot - still_pot) > POT_NOISE;
+  for (byte s = 0; s < NUM_DEPTH_SENSORS; s++) {
+    float distance = ranges[s].status == RANGE_NO_ECHO ? -1 : ranges[s].distance;
+    if (abs(distance - still_distance[s]) > DISTANCE_NOISE) {
+      still_distance[s] = distance;
+      moved = true;
+    }
+  }
+
+  unsigned long time = millis();
+  if (moved) {
+    still_pot = pot;
+    still_since = time;
+    if (still)
+      debugMsg(F("Inputs moved, back to full speed"));
+    still = false;
+  } else if (!still && time - still_since >= STILL_TIME) {
+    debugMsg(F("Inputs still, slowing down"));
+    still = true;
+  }
+}
+
+// Print "#P <awake %> <idle %> <down %> <uA>" for the time since the last one, the share of
+// it spent in each mode and the average current the ATmega328P would have drawn
+void lowPowerTelemetry() {
+  unsigned long time = millis();
+  unsigned long span = time - telemetry_time;
+  if (span < TELEMETRY_INTERVAL)
+    return;
+
+  unsigned long awake = span - min(span, idle_time + down_time);
+  unsigned long current = (awake * CURRENT_AWAKE + idle_time * CURRENT_IDLE + down_time * CURRENT_DOWN) / span;
+  Serial.print(F("#P "));
+  Serial.print(awake * 100 / span);
+  Serial.print(' ');
+  Serial.print(idle_time * 100 / span);
+  Serial.print(' ');
+  Serial.print(down_time * 100 / span);
+  Serial.print(' ');
+  Serial.println(current);
+
+  telemetry_time = time;
+  idle_time = down_time = 0;
+}
+
+// Wait out the end of a loop, sleeping through a longer one while the inputs are still. Wakes
+// early for the LED's next change so blinking and fading keep their time.
+void lowPowerWait() {
+  lowPowerTelemetry();
+  if (!still) {
+    delay(LOOP_DELAY);
+    return;
+  }
+  lowPowerSleep(max((unsigned long)LOOP_DELAY, min((unsigned long)IDLE_LOOP_DELAY, untilLedChange())));
+}
 
 
 // Main functions
 void setup() {
+  memoryPaint();
   Serial.begin(9600);
-  debugMsg("Machine starting up");
+  debugMsg(F("Machine starting up"));
 
-  pinMode(RED_PIN, OUTPUT);
-  pinMode(BLUE_PIN, OUTPUT);
-  pinMode(GREEN_PIN, OUTPUT);
+  RedLed::output();
+  BlueLed::output();
+  GreenLed::output();
   pinMode(POT_PIN, INPUT);
-  pinMode(DEPTH_PINS[0], INPUT);
-  pinMode(DEPTH_PINS[1], OUTPUT);
+  for (byte s = 0; s < NUM_DEPTH_SENSORS; s++) {
+    pinMode(DEPTH_PINS[s][0], INPUT);
+    pinMode(DEPTH_PINS[s][1], OUTPUT);
+  }
+
+  if (configBegin(CONFIG, sizeof(CONFIG) / sizeof(CONFIG[0])))
+    debugMsg(F("Using the saved settings"));
+  logBegin();
+  profilerBegin();
 }
 
 void loop() {
+  traceLoop();
+  memoryReport();
+
+  char command = configPoll(Serial);
+  if (command == 'D')
+    logDump(Serial);
+  else if (command == 'P')
+    profilerDump(Serial);
+  profilerUpdate(Serial);
+
   runStateMachine();
-  delay(LOOP_DELAY);
+  lowPowerWait();
 }
 
 void runStateMachine() {
-  debugMsg("Potentiometer state: ", (char*)String(analogRead(POT_PIN)).c_str());
-  debugMsg("Distance state: ", (char*)String(getDistance()).c_str());
+  const short pot = traceAnalog(POT_PIN);
+  rangingUpdate();
+  if (debug) {
+    debugMsg(F("Potentiometer state: "), pot);
+    debugMsg(F("Distance state: "), ranges[0].distance, flashString(rangeNames, ranges[0].status));
+  }
+  logUpdate(ranges[0].status == RANGE_NO_ECHO ? -1 : ranges[0].distance, pot);
+  lowPowerUpdate(pot);
 
   switch(currentState) {
     case A:
@@ -153,63 +566,67 @@ void runStateMachine() {
   }
 }
 
+// Work the fade step out once when fade_time changes instead of dividing every loop
+void fadeChanged() {
+  fade_step = fade_time/(255/FADE_AMT);
+}
+
 
 // State functions
 void runA() {
-  debugMsg("Runing state A");
+  debugMsg(F("Runing state A"));
 
-  const short pot = analogRead(POT_PIN);
+  const short pot = traceAnalog(POT_PIN);
 
-  if (pot > 90) {
+  if (pot > band_mid) {
     changeState(E);
   }
 
   unsigned long time = millis();
 
-  if (time-last_change >= BLINK_TIME) {
+  if (time-last_change >= blink_time) {
     last_change = time;
     led_state = !led_state;
-    digitalWrite(BLUE_PIN, led_state);
+    BlueLed::write(led_state);
   }
 }
 
 void runB() {
-  debugMsg("Runing state B");
+  debugMsg(F("Runing state B"));
 
-  const short pot = analogRead(POT_PIN);
+  const short pot = traceAnalog(POT_PIN);
 
-  if (pot < 25) {
+  if (pot < band_low) {
     changeState(A);
-  } else if (25 < pot && pot < 90) {
+  } else if (band_low < pot && pot < band_mid) {
     changeState(E);
-  } else if (90 < pot && pot < 120) {
+  } else if (band_mid < pot && pot < band_high) {
     changeState(C);
   }
 
   unsigned long time = millis();
 
-  if (time-last_change >= BLINK_TIME) {
+  if (time-last_change >= blink_time) {
     last_change = time;
     led_state = !led_state;
-    digitalWrite(GREEN_PIN, led_state);
+    GreenLed::write(led_state);
   }
 }
 
 void runC() {
-  debugMsg("Runing state C");
+  debugMsg(F("Runing state C"));
 
-  const short dist = getDistance();
-  const short pot = analogRead(POT_PIN);
+  const short pot = traceAnalog(POT_PIN);
 
-  if (pot < 90) {
+  if (pot < band_mid) {
     changeState(B);
-  } else if (pot > 120 && dist > 20) {
+  } else if (pot > band_high && objectBeyond(near_cm)) {
     changeState(D);
   }
 
   unsigned long time = millis();
 
-  if (time-last_change >= FADE_TIME/(255/FADE_AMT)) {
+  if (time-last_change >= fade_step) {
     last_change = time;
 
     if (led_brightness <= 0) {
@@ -224,24 +641,22 @@ void runC() {
       led_brightness = min(255, led_brightness + FADE_AMT);
     }
 
-    debugMsg("LED brightness: ", (char*)String(led_brightness).c_str());
-    analogWrite(RED_PIN, led_brightness);
+    if (debug)
+      debugMsg(F("LED brightness: "), led_brightness);
+    RedLed::pwmWrite(led_brightness);
   }
 }
 
 void runD() {
-  debugMsg("Runing state D");
-
-  const short dist = getDistance();
-  const short pot = analogRead(POT_PIN);
+  debugMsg(F("Runing state D"));
 
-  if (dist < 20) {
+  if (objectWithin(near_cm)) {
     changeState(F);
   }
 
   unsigned long time = millis();
 
-  if (time-last_change >= FADE_TIME/(255/FADE_AMT)) {
+  if (time-last_change >= fade_step) {
     last_change = time;
 
     if (led_brightness <= 0) {
@@ -256,44 +671,45 @@ void runD() {
       led_brightness = min(255, led_brightness + FADE_AMT);
     }
 
-    debugMsg("LED brightness: ", (char*)String(led_brightness).c_str());
-    analogWrite(RED_PIN, led_brightness);
+    if (debug)
+      debugMsg(F("LED brightness: "), led_brightness);
+    RedLed::pwmWrite(led_brightness);
   }
 }
 
 void runE() {
-  debugMsg("Runing state E");
+  debugMsg(F("Runing state E"));
 
-  const short pot = analogRead(POT_PIN);
+  const short pot = traceAnalog(POT_PIN);
 
-  if (pot < 25) {
+  if (pot < band_low) {
     changeState(B);
   }
 
   unsigned long time = millis();
 
-  if (time-last_change >= BLINK_TIME) {
+  if (time-last_change >= blink_time) {
     last_change = time;
     led_state = !led_state;
-    digitalWrite(RED_PIN, led_state);
+    RedLed::pwmOff(); // from fading in C, D or F
+    RedLed::write(led_state);
   }
 }
 
 void runF() {
-  debugMsg("Runing state F");
+  debugMsg(F("Runing state F"));
 
-  const short dist = getDistance();
-  const short pot = analogRead(POT_PIN);
+  const short pot = traceAnalog(POT_PIN);
 
-  if (pot < 20) {
+  if (pot < f_band_low) {
     changeState(C);
-  } else if (20 < pot && pot < 40) {
+  } else if (f_band_low < pot && pot < f_band_high) {
     changeState(D);
   }
 
   unsigned long time = millis();
 
-  if (time-last_change >= FADE_TIME/(255/FADE_AMT)) {
+  if (time-last_change >= fade_step) {
     last_change = time;
 
     if (led_brightness <= 0) {
@@ -308,7 +724,8 @@ void runF() {
       led_brightness = min(255, led_brightness + FADE_AMT);
     }
 
-    debugMsg("LED brightness: ", (char*)String(led_brightness).c_str());
-    analogWrite(RED_PIN, led_brightness);
+    if (debug)
+      debugMsg(F("LED brightness: "), led_brightness);
+    RedLed::pwmWrite(led_brightness);
   }
 }
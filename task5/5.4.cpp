@@ -8,354 +8,160 @@
  * The switch is the door interlock (it would be a button actuated by the door closing).
  * The light ring represents the current state of the microwave.
  * The time is set using the potentiometer.
+ * The shortest and longest times and how long it stays finished are settings, send "list" over serial to see them.
+ * The states themselves are in libraries/Microwave/Microwave.h, which multiapp's microwave app runs as well.
+ * Define RING_USART to send the ring from the USART a light at a time, so interrupts are never off
+ * for the whole ring. It moves to pin 1 and the interlock to pin 7, and there's no serial.
  */
 
 #include <Adafruit_NeoPixel.h>
 
+// Pins worked out at compile time, from libraries/
+#include <FastPin.h>
+
+// tables of names in flash, from libraries/
+#include <FlashString.h>
+
+// settings changed over serial and kept in the EEPROM, from libraries/
+#include <ConfigStore.h>
+
+// "#M" lines of how much RAM is used, from libraries/
+//#define MEMORY_REPORT
+#include <MemoryReport.h>
+
+// "#T" lines of every input read, for host/replay, from libraries/
+//#define TRACE
+#include <InputTrace.h>
+
+//#define RING_USART      // send the LED ring from the USART instead of Adafruit_NeoPixel, see "LED ring output"
+#if defined(RING_USART) && !defined(NO_DEBUG)
+#define NO_DEBUG          // no debug messages, the USART is the ring's. The host fuzzer builds with NO_DEBUG too
+#endif
+
+// the microwave's state machine, shared with multiapp's microwave app, from libraries/. It sets
+// the cook time from the pot with DialMap.h
+#include <Microwave.h>
 
-// Global Variables
-enum State {
-  WAITING,
-  RUNNING,
-  PAUSED,
-  FINISHED,
-};
-char* state_names[] {
-  "Waiting",
-  "Running",
-  "Paused",
-  "Finished",
-};
 
 // Pins to various devices
-#define DEBUG             // print debug messages if enabled
 #define LOOP_DELAY 20     // delay the loop speed for simulations
 #define POT_PIN A5        // potentiometer
 #define STARTPAUSE_PIN 2  // start/pause button
 #define STOP_PIN 3        // stop button
 #define MICROWAVE_PIN 5   // the microwave relay used to control the motor and magnetron
+#ifdef RING_USART
+#define INTERLOCK_PIN 7   // the door interlock, pin 4 is the USART's clock
+#define LED_RING_PIN 1    // the USART's TX
+#define USART_PINS Pin<4>
+#else
 #define INTERLOCK_PIN 4   // the door interlock that stops the microwave if door is opened
 #define LED_RING_PIN 6    // controls the LED ring
-#define LED_RING_SIZE 12  // number of lights on the LED ring
-
-#define MAX_DURATION 5000         // in milliseconds
-#define MIN_DURATION 500          // in milliseconds
-#define BUTTON_DEBOUNCE_DELAY 200 // ms to wait until another button can be pressed
-#define FINISHED_TIME 4000        // time to stay on finished state after timer runs out
-#define FLASH_TIME 500            // time to flash all lights on
-#define LIGHT_SPIN_LENGTH 4       // how many LEDs are lit when spinning
-#define SPIN_TIME 100             // move the spin around every this many ms
-#define FINISH_FLASH_COLOUR strip.Color(127, 127, 0)  // flash this color when done
-#define SPIN_COLOUR strip.Color(0, 0, 255)            // the spinning is this color
-#define PAUSED_FLASH_COLOUR strip.Color(0, 255, 0)    // flash this color when paused
-
-
-State curr_state = WAITING;     // current state
-State last_state = PAUSED;      // the state immediately before the current runStateMachine cycle
-long timer = 0;                 // time to run for once started
-long start_time = 0;            // when a state started running.
-long led_start_time = 0;        // when the lights made their last state change.
-long last_button_press = 0;     // ms time the last button was pressed.
-int pot = 0;                    // potentiometer value at beginning of loop
-int last_pot = 0;               // last potentiometer value for printing out changes
-int curr_led = 0;               // progress when spinning the light wheel.
-bool startpause_button = false; // whether the startpause_button is pressed.
-bool stop_button = false;       // whether the stop button is pressed.
-bool interlock = false;         // whether the interlock switch is pressed.
-bool finished_flashing = false; // whether the finished animation is all on or all off.
+#define USART_PINS Pin<0>, Pin<1>
+#endif
+typedef Pin<MICROWAVE_PIN> MicrowaveRelay;
+static_assert(PinLayout<Pin<POT_PIN>, Pin<STARTPAUSE_PIN>, Pin<STOP_PIN>, MicrowaveRelay, Pin<INTERLOCK_PIN>,
+                        Pin<LED_RING_PIN>, USART_PINS>::distinct,
+              "two things are on the same pin, serial is on 0 and 1, or the ring's clock on 4");
+#define LED_RING_SIZE MICROWAVE_RING_SIZE // number of lights on the LED ring
+
+
+// Settings
+// Changed over serial while the sketch runs and kept in the EEPROM. A line starting with a
+// capital letter is one of the sketch's one letter commands as before, any other line is for the
+// console: list, get <name>, set <name> <value>, commit, revert or erase. They're the
+// microwave's, see Microwave.h.
+constexpr ConfigParam CONFIG[] PROGMEM = {MICROWAVE_CONFIG};
+CONFIG_CHECK(CONFIG);
+
+#ifndef RING_USART
 Adafruit_NeoPixel strip = Adafruit_NeoPixel(
   LED_RING_SIZE,
   LED_RING_PIN,
   NEO_GRB + NEO_KHZ800
 );
-
-// Helper functions for everyone
-// print a debug message if DEBUG is defined, optionally append data to the message
-void debugMsg(String msg, String data="") {
-  #ifdef DEBUG
-
-  Serial.print("(");
-  Serial.print(state_names[curr_state]);
-  Serial.print(") ");
-
-  if (data != "") {
-    Serial.print(msg);
-    Serial.println(data);
-  } else {
-    Serial.println(msg);
-  }
-  #endif // DEBUG
-}
-
-// this fixes the new Arduino build system declaration bug and allows enum arguments
-void changeState(State n);
-// change to another state
-void changeState(State n) {
-  curr_state = n;
-  debugMsg("Changing to state: ", String(state_names[n]));
-}
-
-// update the potentiometer value
-void readPot() {
-  pot = analogRead(POT_PIN);
-
-  if (pot != last_pot) {
-    debugMsg("Potentiometer state: ", String(pot));
-    last_pot = pot;
-  }
-}
-
-// update button states
-void readButtons() {
-  bool state;
-  long now = millis();
-
-  if (now-last_button_press >= BUTTON_DEBOUNCE_DELAY) {
-    // start/pause button
-    state = digitalRead(STARTPAUSE_PIN);
-    if (state != startpause_button) {
-      debugMsg("Updated start/pause button to ", String(state));
-      startpause_button = state;
-    }
-
-    // stop button
-    state = digitalRead(STOP_PIN);
-    if (state != stop_button) {
-      debugMsg("Updated stop button to ", String(state));
-      stop_button = state;
-    }
-
-    // interlock button
-    state = digitalRead(INTERLOCK_PIN);
-    if (state != interlock) {
-      debugMsg("Updated interlock button to ", String(state));
-      interlock = state;
-    }
-  }
-}
+#endif
 
 // set the microwave relay state (motor and magnetron)
-void microwaveState(bool state) {
-  debugMsg("Changing microwave state: ", String(state));
-  if (state) {
-    digitalWrite(MICROWAVE_PIN, HIGH);
-  } else {
-    digitalWrite(MICROWAVE_PIN, LOW);
-  }
+void microwaveRelay(bool on) {
+  MicrowaveRelay::write(on);
 }
 
-// set all of the lights in the LED ring
-void setAllLights(int colour) {
-  for (int i = 0; i < LED_RING_SIZE; i++) {
-    strip.setPixelColor(i, colour);
-  }
-  strip.show();
+// LED ring output
+// Adafruit_NeoPixel::show() turns interrupts off for the whole ring, 30 us a light. With
+// RING_USART defined the ring is sent from the USART in master SPI mode instead, see
+// PixelUSART.h. The USART is Serial's, so its TX on pin 1 drives the ring, pin 4 is its clock and
+// there are no debug messages or settings console. Define PIXEL_DOUBLE as well to keep a second
+// frame that can be changed while one goes out.
+#ifdef RING_USART
+#if defined(TRACE) || defined(MEMORY_REPORT)
+#error "TRACE and MEMORY_REPORT print over serial, which RING_USART takes for the ring"
+#endif
+#define PIXEL_COUNT LED_RING_SIZE
+#include <PixelUSART.h>
+static_assert(PIXEL_PIN == LED_RING_PIN, "the ring is on the USART's TX pin");
+#endif
+
+// set one light of the ring, shown at the next microwaveRingShow()
+void microwaveRing(uint8_t i, uint32_t colour) {
+#ifdef RING_USART
+  pixelSet(i, colour);
+#else
+  strip.setPixelColor(i, colour);
+#endif
 }
 
-// start spinning the LED ring lights
-void spinLights() {
-  int on[LIGHT_SPIN_LENGTH] = {};
-
-  for (int i = 0; i < LIGHT_SPIN_LENGTH; i++) {
-    on[i] = (curr_led + i) % LED_RING_SIZE;
-  }
-
-  for (int l = 0; l < LED_RING_SIZE; l++) {
-    bool set_led = false;
-
-    for (int i = 0; i < LIGHT_SPIN_LENGTH; i++) {
-      if (l == on[i]) {
-        strip.setPixelColor(l, SPIN_COLOUR);
-        set_led = true;
-      }
-    }
-
-    if (!set_led) {
-      strip.setPixelColor(l, 0);
-    }
-  }
+// show what the ring has been set to
+void microwaveRingShow() {
+#ifdef RING_USART
+  pixelShow();
+#else
   strip.show();
-
-  curr_led = (curr_led+1) % LED_RING_SIZE;
+#endif
 }
 
 
 // Main functions
 void setup() {
+  memoryPaint();
+#ifndef RING_USART
   Serial.begin(115200);
-  debugMsg("Starting up");
-
-  changeState(WAITING);
+#endif
+  microwaveBegin();
 
   pinMode(POT_PIN, INPUT);
   pinMode(STARTPAUSE_PIN, INPUT);
   pinMode(STOP_PIN, INPUT);
   pinMode(INTERLOCK_PIN, INPUT);
-  pinMode(MICROWAVE_PIN, OUTPUT);
+  MicrowaveRelay::output();
   pinMode(LED_RING_PIN, OUTPUT);
 
+#ifdef RING_USART
+  pixelBegin();
+#else
   strip.begin();
   strip.setBrightness(255);
-}
-
-void loop() {
-  runStateMachine();
-  delay(LOOP_DELAY);
-}
-
-void runStateMachine() {
-  State before_change = curr_state;
-  readPot();
-  readButtons();
-
-  switch(curr_state) {
-    case WAITING:
-      waiting();
-      break;
-    case RUNNING:
-      running();
-      break;
-    case PAUSED:
-      paused();
-      break;
-    case FINISHED:
-      finished();
-      break;
-    default:
-      debugMsg("Invalid state? Try restarting the device?");
-      break;
-  }
-
-  last_state = before_change;
-}
-
-
-// State functions
-void waiting() {
-  // if we just switched to this state
-  if (last_state != WAITING) {
-    debugMsg("Waiting...");
-    setAllLights(0);
-  }
-
-  // don't ever leave this state when door open
-  if (startpause_button && interlock) {
-    startpause_button = false; // prevent the next state from thinking the button is pressed.
-
-    // set the timer
-    timer = map(pot, 0, 1023, MIN_DURATION, MAX_DURATION);
-    debugMsg("Set timer for ", String(timer));
-    changeState(RUNNING);
-  }
-}
-
-void running() {
-  long curr_time = millis();
+#endif
 
-  // if we just switched to this state
-  if (last_state != RUNNING) {
-    debugMsg("Running...");
-    debugMsg("Timer T-", String(timer));
-    start_time = millis();
-  }
-  else {
-    debugMsg("Timer T-", String(timer-(curr_time-start_time)));
-  }
-
-  if (!interlock) {
-    microwaveState(false);
-    changeState(PAUSED);
-  }
-  else if (timer-(curr_time-start_time) <= 0) { // timer is finished
-    microwaveState(false);
-    changeState(FINISHED);
-  }
-  else if (startpause_button) {
-    startpause_button = false; // prevent the next state from thinking the button is pressed.
-
-    timer -= curr_time-start_time; // set timer to remaining time.
-    microwaveState(false);
-    changeState(PAUSED);
-  }
-  else if (stop_button) {
-    stop_button = false;
-
-    microwaveState(false);
-    changeState(WAITING);
-  }
-  else { // microwave is still running
-    microwaveState(true);
-
-    // update light spinning
-    if (curr_time-led_start_time >= SPIN_TIME) {
-      debugMsg("Spinning lights");
-      spinLights();
-    }
-  }
+  if (configBegin(CONFIG, sizeof(CONFIG) / sizeof(CONFIG[0])))
+    microwaveDebug(F("Using the saved settings"));
 }
 
-void paused() {
-  long curr_time = millis();
-
-  // if we just switched to this state
-  if (last_state != PAUSED) {
-    debugMsg("Paused...");
-  }
-
-  if (startpause_button) {
-    debugMsg("Resuming...");
-    startpause_button = false; // prevent the next state from thinking the button is pressed.
-
-    setAllLights(0);
-    changeState(RUNNING);
-  }
-  else if (stop_button) {
-    stop_button = false;
-
-    setAllLights(0);
-    changeState(WAITING);
-  }
-  else if (curr_time-led_start_time >= FLASH_TIME) { // flash lights
-    finished_flashing = !finished_flashing;
-    led_start_time = curr_time;
-
-    if (finished_flashing) {
-      debugMsg("Flashing on");
-      setAllLights(PAUSED_FLASH_COLOUR);
-    } else {
-      setAllLights(0);
-      debugMsg("Flashing off");
-    }
-  }
-}
-
-void finished() {
-  long curr_time = millis();
-
-  // if we just switched to this state
-  if (last_state != FINISHED) {
-    debugMsg("Finished...");
-    start_time = curr_time;
-    led_start_time = curr_time;
-  }
-
-  if (!interlock) {
-    changeState(WAITING);
-  }
-  else if (curr_time-start_time >= FINISHED_TIME) {
-    changeState(WAITING);
-    setAllLights(0);
-  }
-  else if (curr_time-led_start_time >= FLASH_TIME) { // flash lights
-    finished_flashing = !finished_flashing;
-    led_start_time = curr_time;
+void loop() {
+  traceLoop();
+  memoryReport();
+#ifndef RING_USART
+  configPoll(Serial);
+#endif
+
+  // one at a time, so a trace has them in the same order every build
+  int pot = traceAnalog(POT_PIN);
+  bool start_pause = traceDigital(STARTPAUSE_PIN);
+  bool stop = traceDigital(STOP_PIN);
+  bool interlock = traceDigital(INTERLOCK_PIN);
+  microwaveStep(pot, start_pause, stop, interlock);
+#ifdef RING_USART
+  pixelDone(); // sends the ring again if another interrupt broke it
+#endif
 
-    if (finished_flashing) {
-      debugMsg("Flashing on");
-      setAllLights(FINISH_FLASH_COLOUR);
-    } else {
-      setAllLights(0);
-      debugMsg("Flashing off");
-    }
-  }
+  delay(LOOP_DELAY);
 }